@@ -0,0 +1,91 @@
+; Highlight query for C, see src/query.c for the supported captures and predicates.
+; When patterns capture the same text, the later pattern wins.
+
+; Keywords
+
+[
+  "break"
+  "case"
+  "continue"
+  "do"
+  "else"
+  "enum"
+  "for"
+  "goto"
+  "if"
+  "return"
+  "sizeof"
+  "struct"
+  "switch"
+  "typedef"
+  "union"
+  "while"
+  (true)
+  (false)
+] @keyword
+
+[
+  "#include"
+  "#ifdef"
+  "#endif"
+  "#ifndef"
+  "#define"
+] @keyword.directive
+
+; Types
+
+[
+  (storage_class_specifier)
+  (type_qualifier)
+  (primitive_type)
+  (type_identifier)
+  (sized_type_specifier)
+] @type
+
+; Literals
+
+(number_literal) @number
+
+[
+  (string_literal)
+  (system_lib_string)
+  (char_literal)
+] @string
+
+(escape_sequence) @string.escape
+
+(null) @constant.builtin
+
+; Punctuation
+
+["(" ")" "{" "}" "[" "]" ";" "."] @punctuation
+
+["?" ":"] @operator
+
+; Pointers and unary operators
+
+(unary_expression operator: _ @keyword)
+(pointer_expression operator: _ @keyword)
+(pointer_declarator "*" @keyword)
+(abstract_pointer_declarator "*" @keyword)
+
+; Functions
+
+(function_declarator declarator: (_) @function)
+(call_expression function: (identifier) @function)
+
+; Fields
+
+(field_identifier) @property
+
+; Identifiers
+
+((identifier) @keyword
+  (#eq? @keyword "class"))
+
+((identifier) @constant
+  (#name? @constant "constant"))
+
+; Comments
+
+(comment) @comment
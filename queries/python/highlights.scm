@@ -0,0 +1,89 @@
+; Highlight query for Python, see src/query.c for the supported captures and predicates.
+; When patterns capture the same text, the later pattern wins.
+
+; Keywords
+
+[
+  "and"
+  "as"
+  "assert"
+  "break"
+  "class"
+  "continue"
+  "def"
+  "del"
+  "elif"
+  "else"
+  "except"
+  "finally"
+  "for"
+  "from"
+  "global"
+  "if"
+  "import"
+  "in"
+  "is"
+  "lambda"
+  "nonlocal"
+  "not"
+  "or"
+  "pass"
+  "raise"
+  "return"
+  "try"
+  "while"
+  "with"
+  "yield"
+] @keyword
+
+[
+  (true)
+  (false)
+  (none)
+] @constant.builtin
+
+; Literals
+
+[
+  (integer)
+  (float)
+] @number
+
+(string) @string
+
+(escape_sequence) @string.escape
+
+; Punctuation
+
+["(" ")" "{" "}" "[" "]" "."] @punctuation
+
+":" @operator
+
+; Exceptions
+
+(except_clause . (_) @type)
+
+; Arguments
+
+(keyword_argument name: (identifier) @label)
+
+; Fields
+
+(attribute attribute: (identifier) @property)
+
+; Functions
+
+(call function: (identifier) @function)
+(call function: (attribute attribute: (identifier) @function))
+
+; Identifiers
+
+((identifier) @constant
+  (#name? @constant "constant"))
+
+((identifier) @constant
+  (#name? @constant "dunder"))
+
+; Comments
+
+(comment) @comment
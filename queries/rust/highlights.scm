@@ -0,0 +1,123 @@
+; Highlight query for Rust, see src/query.c for the supported captures and predicates.
+; When patterns capture the same text, the later pattern wins.
+
+; Keywords
+
+[
+  "as"
+  "async"
+  "await"
+  "break"
+  "const"
+  "continue"
+  "dyn"
+  "else"
+  "enum"
+  "extern"
+  "false"
+  "fn"
+  "for"
+  "if"
+  "impl"
+  "in"
+  "let"
+  "loop"
+  "match"
+  "mod"
+  "move"
+  "pub"
+  "ref"
+  "return"
+  "static"
+  "struct"
+  "trait"
+  "true"
+  "type"
+  "unsafe"
+  "use"
+  "where"
+  "while"
+  (crate)
+  (self)
+  (super)
+  (mutable_specifier)
+] @keyword
+
+; Types
+
+[
+  (primitive_type)
+  (type_identifier)
+] @type
+
+(meta_item) @attribute
+
+(use_list) @type
+
+(use_wildcard) @none
+
+; Literals
+
+[
+  (integer_literal)
+  (float_literal)
+] @number
+
+[
+  (string_literal)
+  (raw_string_literal)
+  (char_literal)
+] @string
+
+(escape_sequence) @string.escape
+
+; Punctuation
+
+["(" ")" "{" "}" "[" "]" "<" ">" ";" "." "::" "&"] @punctuation
+
+["?" ":" "->" "=>" "#"] @operator
+
+; Paths
+
+(scoped_identifier path: (_) @module)
+(scoped_type_identifier path: (_) @module)
+
+((scoped_identifier name: (identifier) @type)
+  (#name? @type "capitalized"))
+
+; Patterns
+
+(parameter pattern: (_) @parameter)
+
+(match_pattern . (identifier) @type)
+(tuple_struct_pattern type: (_) @type)
+
+(enum_variant name: (identifier) @constant)
+
+; Fields
+
+(field_identifier) @property
+
+; Functions
+
+(function_item name: (identifier) @function)
+(call_expression function: (identifier) @function)
+(call_expression function: (scoped_identifier name: (identifier) @function))
+(call_expression function: (field_expression field: (field_identifier) @function))
+
+(macro_invocation macro: (identifier) @function.macro "!" @function.macro)
+
+; Identifiers
+
+((identifier) @constant.builtin
+  (#name? @constant.builtin "keyword2"))
+
+((identifier) @constant
+  (#name? @constant "constant"))
+
+; Comments
+
+[
+  (line_comment)
+  (block_comment)
+] @comment
@@ -0,0 +1,156 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Stored in front of every block, so blocks can be grown and freed without knowing their size
+ */
+typedef struct arenaHeader {
+    // Size class of the block, ARENA_CLASSES for blocks allocated on their own
+    unsigned int class;
+    // Number of usable bytes in the block
+    unsigned int capacity;
+} arenaHeader;
+
+/*
+ * Free block of a size class, the link is stored in the block itself
+ */
+typedef struct arenaFreeBlock {
+    struct arenaFreeBlock *next;
+} arenaFreeBlock;
+
+/*
+ * Allocator state, rows are only modified by the editor thread so no locking is needed
+ */
+struct arena {
+    // Free blocks of each size class
+    arenaFreeBlock *free[ARENA_CLASSES];
+
+    // Unused part of the current slab
+    char *slab;
+    size_t slabLeft;
+};
+
+struct arena A = { {NULL}, NULL, 0 };
+
+/*** arena ***/
+
+/*
+ * Return the smallest size class holding `size` bytes, ARENA_CLASSES if no class is large enough
+ */
+unsigned int arenaClass(size_t size) {
+    unsigned int class = 0;
+    size_t capacity = ARENA_MIN_BLOCK;
+
+    while (class < ARENA_CLASSES && capacity < size) {
+        capacity *= 2;
+        class++;
+    }
+
+    return class;
+}
+
+/*
+ * Allocate a block of at least `size` bytes for row storage.
+ * Small blocks are carved from large slabs and reused through free lists per size class,
+ * larger blocks are allocated with a power of two capacity.
+ */
+void *arenaAlloc(size_t size) {
+    unsigned int class = arenaClass(size);
+    arenaHeader *header;
+
+    if (class == ARENA_CLASSES) {
+        // Too large for a size class, round up so growing the block stays amortized O(1)
+        size_t capacity = (size_t)ARENA_MIN_BLOCK << ARENA_CLASSES;
+        while (capacity < size) {
+            capacity *= 2;
+        }
+
+        header = malloc(sizeof(arenaHeader) + capacity);
+        header->class = class;
+        header->capacity = capacity;
+
+        return header + 1;
+    }
+
+    // Reuse a freed block of the same class
+    if (A.free[class] != NULL) {
+        arenaFreeBlock *block = A.free[class];
+        A.free[class] = block->next;
+
+        return block;
+    }
+
+    size_t blockSize = sizeof(arenaHeader) + ((size_t)ARENA_MIN_BLOCK << class);
+
+    // Start a new slab when the current one is used up, the rest of the old slab is left unused
+    if (A.slabLeft < blockSize) {
+        A.slab = malloc(ARENA_SLAB_SIZE);
+        A.slabLeft = ARENA_SLAB_SIZE;
+    }
+
+    header = (arenaHeader *)A.slab;
+    header->class = class;
+    header->capacity = ARENA_MIN_BLOCK << class;
+
+    A.slab += blockSize;
+    A.slabLeft -= blockSize;
+
+    return header + 1;
+}
+
+/*
+ * Grow (or keep) block `ptr` so it holds at least `size` bytes, keeping its contents.
+ * Capacities grow geometrically, so growing a block one byte at a time is amortized O(1).
+ * `ptr` may be NULL.
+ */
+void *arenaRealloc(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return arenaAlloc(size);
+    }
+
+    arenaHeader *header = (arenaHeader *)ptr - 1;
+
+    if (size <= header->capacity) {
+        return ptr;
+    }
+
+    // Blocks outside the size classes are grown in place by the C library when possible
+    if (header->class == ARENA_CLASSES) {
+        size_t capacity = header->capacity;
+        while (capacity < size) {
+            capacity *= 2;
+        }
+
+        header = realloc(header, sizeof(arenaHeader) + capacity);
+        header->capacity = capacity;
+
+        return header + 1;
+    }
+
+    void *block = arenaAlloc(size);
+    memcpy(block, ptr, header->capacity);
+    arenaFree(ptr);
+
+    return block;
+}
+
+/*
+ * Return block `ptr` to its size class, `ptr` may be NULL
+ */
+void arenaFree(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    arenaHeader *header = (arenaHeader *)ptr - 1;
+
+    if (header->class == ARENA_CLASSES) {
+        free(header);
+        return;
+    }
+
+    arenaFreeBlock *block = ptr;
+    block->next = A.free[header->class];
+    A.free[header->class] = block;
+}
@@ -0,0 +1,40 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Capacity of the smallest size class in bytes
+ */
+#define ARENA_MIN_BLOCK 16
+
+/*
+ * Number of size classes, each class doubles the capacity of the previous one (16 bytes up to 4KB)
+ */
+#define ARENA_CLASSES 9
+
+/*
+ * Size of the slabs the blocks of the size classes are carved from
+ */
+#define ARENA_SLAB_SIZE (1 << 20)
+
+/*
+ * Allocate a block of at least `size` bytes for row storage.
+ * Small blocks are carved from large slabs and reused through free lists per size class,
+ * larger blocks are allocated with a power of two capacity.
+ */
+void *arenaAlloc(size_t size);
+
+/*
+ * Grow (or keep) block `ptr` so it holds at least `size` bytes, keeping its contents.
+ * Capacities grow geometrically, so growing a block one byte at a time is amortized O(1).
+ * `ptr` may be NULL.
+ */
+void *arenaRealloc(void *ptr, size_t size);
+
+/*
+ * Return block `ptr` to its size class, `ptr` may be NULL
+ */
+void arenaFree(void *ptr);
+
+#endif
@@ -0,0 +1,731 @@
+#include "buffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*** row tree ***/
+
+/*
+ * Returns `true` if a node or leaf created at `epoch` may be read by a snapshot, so it must be copied before it is modified
+ */
+bool rowTreeFrozen(rowTree *tree, int epoch) {
+    return epoch < tree->frozen;
+}
+
+/*
+ * Free the node or leaf `node` created at `epoch` that was removed from the tree,
+ * or keep it until the snapshots that may read it are released
+ */
+void rowTreeRetire(rowTree *tree, void *node, int epoch) {
+    if (!rowTreeFrozen(tree, epoch)) {
+        free(node);
+        return;
+    }
+
+    if (tree->retiredCount == tree->retiredCapacity) {
+        tree->retiredCapacity = tree->retiredCapacity ? tree->retiredCapacity * 2 : 64;
+        tree->retired = realloc(tree->retired, sizeof(rowRetired) * tree->retiredCapacity);
+    }
+
+    tree->retired[tree->retiredCount++] = (rowRetired){node, tree->epoch};
+}
+
+/*
+ * Return a copy of inner node `node` that can be modified, the node itself stays as the snapshots see it
+ */
+rowNode *rowTreeCopyNode(rowTree *tree, rowNode *node) {
+    rowNode *copy = malloc(sizeof(rowNode));
+    memcpy(copy, node, sizeof(rowNode));
+    copy->epoch = tree->epoch;
+
+    rowTreeRetire(tree, node, node->epoch);
+    return copy;
+}
+
+/*
+ * Return a copy of `leaf` that can be modified and link it in place of the leaf
+ */
+rowLeaf *rowTreeCopyLeaf(rowTree *tree, rowLeaf *leaf) {
+    rowLeaf *copy = malloc(sizeof(rowLeaf));
+    memcpy(copy, leaf, sizeof(rowLeaf));
+    copy->epoch = tree->epoch;
+
+    // The snapshots keep reading the characters of the rows through the old leaf
+    memset(copy->shared, true, sizeof(bool) * copy->count);
+
+    // Snapshots don't follow the links, so they can be changed in frozen leaves
+    if (copy->prev) {
+        copy->prev->next = copy;
+    } else {
+        tree->first = copy;
+    }
+
+    if (copy->next) {
+        copy->next->prev = copy;
+    }
+
+    rowTreeRetire(tree, leaf, leaf->epoch);
+    return copy;
+}
+
+/*
+ * Walk from the root to the leaf containing the row at index `at`, adding `delta` to the row counts
+ * and `bytes_delta` to the byte counts on the way down. Stores the position in the leaf in `slot`.
+ * If `path` is given, the inner nodes and the followed child indexes are stored in `path` and `path_index`.
+ * The frozen nodes and leaf on the way are copied, so the returned leaf and the nodes in `path` can be modified.
+ * Lookups use rowNodeFind, which does not write, so other threads can look up rows at the same time.
+ */
+rowLeaf *rowTreeDescend(rowTree *tree, int at, int *slot, rowNode **path, int *path_index, int delta, long bytes_delta) {
+    if (rowTreeFrozen(tree, tree->root->epoch)) {
+        tree->root = rowTreeCopyNode(tree, tree->root);
+    }
+
+    void *node = tree->root;
+
+    for (int level = 0; level < tree->height; level++) {
+        rowNode *inner = node;
+
+        // Find the child containing the row, rows past the end belong to the last child
+        int i = 0;
+        while (i < inner->count - 1 && at >= inner->rows[i]) {
+            at -= inner->rows[i];
+            i++;
+        }
+
+        inner->rows[i] += delta;
+        inner->bytes[i] += bytes_delta;
+
+        if (level == tree->height - 1) {
+            rowLeaf *leaf = inner->child[i];
+            if (rowTreeFrozen(tree, leaf->epoch)) {
+                inner->child[i] = rowTreeCopyLeaf(tree, leaf);
+            }
+        } else {
+            rowNode *child = inner->child[i];
+            if (rowTreeFrozen(tree, child->epoch)) {
+                inner->child[i] = rowTreeCopyNode(tree, child);
+            }
+        }
+
+        if (path) {
+            path[level] = inner;
+            path_index[level] = i;
+        }
+
+        node = inner->child[i];
+    }
+
+    *slot = at;
+    return node;
+}
+
+/*
+ * Walk from inner node `root`, `height` levels above the leaves, to the leaf containing the row at index `at`
+ * without modifying anything. Stores the position in the leaf in `slot`.
+ */
+rowLeaf *rowNodeFind(void *root, int height, int at, int *slot) {
+    void *node = root;
+
+    for (int level = 0; level < height; level++) {
+        rowNode *inner = node;
+
+        int i = 0;
+        while (i < inner->count - 1 && at >= inner->rows[i]) {
+            at -= inner->rows[i];
+            i++;
+        }
+
+        node = inner->child[i];
+    }
+
+    *slot = at;
+    return node;
+}
+
+/*
+ * Walk from inner node `root`, `height` levels above the leaves, to the leaf containing byte offset `byte`
+ * without modifying anything. Stores the byte offset and the index of the first row of the leaf in `start` and `row`.
+ */
+rowLeaf *rowNodeFindByte(void *root, int height, long byte, long *start, int *row) {
+    *start = 0;
+    *row = 0;
+    void *node = root;
+
+    for (int level = 0; level < height; level++) {
+        rowNode *inner = node;
+
+        int i = 0;
+        while (i < inner->count - 1 && byte >= *start + inner->bytes[i]) {
+            *start += inner->bytes[i];
+            *row += inner->rows[i];
+            i++;
+        }
+
+        node = inner->child[i];
+    }
+
+    return node;
+}
+
+/*
+ * Return the total number of rows below inner node `node`
+ */
+int rowNodeRows(rowNode *node) {
+    int sum = 0;
+    for (int i = 0; i < node->count; i++) {
+        sum += node->rows[i];
+    }
+
+    return sum;
+}
+
+/*
+ * Return the total number of bytes below inner node `node`
+ */
+long rowNodeBytes(rowNode *node) {
+    long sum = 0;
+    for (int i = 0; i < node->count; i++) {
+        sum += node->bytes[i];
+    }
+
+    return sum;
+}
+
+/*
+ * Return the number of bytes in the first `count` rows of `leaf`, including a newline per row
+ */
+long rowLeafBytes(rowLeaf *leaf, int count) {
+    long sum = count;
+    for (int i = 0; i < count; i++) {
+        sum += leaf->size[i];
+    }
+
+    return sum;
+}
+
+/*
+ * Insert `child` containing `rows` rows and `bytes` bytes at position `at` in inner node `node`,
+ * which must not be full
+ */
+void rowNodeInsertChild(rowNode *node, int at, void *child, int rows, long bytes) {
+    memmove(&node->child[at + 1], &node->child[at], sizeof(void *) * (node->count - at));
+    memmove(&node->rows[at + 1], &node->rows[at], sizeof(int) * (node->count - at));
+    memmove(&node->bytes[at + 1], &node->bytes[at], sizeof(long) * (node->count - at));
+
+    node->child[at] = child;
+    node->rows[at] = rows;
+    node->bytes[at] = bytes;
+    node->count++;
+}
+
+/*
+ * The child at `path_index[level]` of `path[level]` has been split, `sibling` holds its upper half.
+ * Sets the row and byte counts of both halves and inserts `sibling` after the child,
+ * splitting inner nodes up to the root when they are full.
+ */
+void rowTreeInsertSibling(rowTree *tree, rowNode **path, int *path_index, int level, void *sibling,
+                          int left_rows, long left_bytes, int right_rows, long right_bytes) {
+    rowNode *node = path[level];
+    int i = path_index[level];
+
+    node->rows[i] = left_rows;
+    node->bytes[i] = left_bytes;
+
+    if (node->count < ROW_NODE_MAX) {
+        rowNodeInsertChild(node, i + 1, sibling, right_rows, right_bytes);
+        return;
+    }
+
+    // Node is full, move its upper half to a new node
+    int half = ROW_NODE_MAX / 2;
+    rowNode *right = malloc(sizeof(rowNode));
+    right->count = node->count - half;
+    right->epoch = tree->epoch;
+    memcpy(right->child, &node->child[half], sizeof(void *) * right->count);
+    memcpy(right->rows, &node->rows[half], sizeof(int) * right->count);
+    memcpy(right->bytes, &node->bytes[half], sizeof(long) * right->count);
+    node->count = half;
+
+    if (i + 1 <= half) {
+        rowNodeInsertChild(node, i + 1, sibling, right_rows, right_bytes);
+    } else {
+        rowNodeInsertChild(right, i + 1 - half, sibling, right_rows, right_bytes);
+    }
+
+    if (level == 0) {
+        // Root was split, grow the tree by one level
+        rowNode *root = malloc(sizeof(rowNode));
+        root->count = 2;
+        root->epoch = tree->epoch;
+        root->child[0] = node;
+        root->rows[0] = rowNodeRows(node);
+        root->bytes[0] = rowNodeBytes(node);
+        root->child[1] = right;
+        root->rows[1] = rowNodeRows(right);
+        root->bytes[1] = rowNodeBytes(right);
+
+        tree->root = root;
+        tree->height++;
+    } else {
+        rowTreeInsertSibling(tree, path, path_index, level - 1, right,
+                             rowNodeRows(node), rowNodeBytes(node), rowNodeRows(right), rowNodeBytes(right));
+    }
+}
+
+/*
+ * Remove the child at `path_index[level]` from `path[level]`,
+ * removing inner nodes that become empty on the way up
+ */
+void rowTreeRemoveChild(rowTree *tree, rowNode **path, int *path_index, int level) {
+    rowNode *node = path[level];
+    int i = path_index[level];
+
+    memmove(&node->child[i], &node->child[i + 1], sizeof(void *) * (node->count - i - 1));
+    memmove(&node->rows[i], &node->rows[i + 1], sizeof(int) * (node->count - i - 1));
+    memmove(&node->bytes[i], &node->bytes[i + 1], sizeof(long) * (node->count - i - 1));
+    node->count--;
+
+    if (node->count > 0) {
+        return;
+    }
+
+    free(node);
+
+    if (level == 0) {
+        tree->root = NULL;
+        tree->height = 0;
+        tree->first = NULL;
+    } else {
+        rowTreeRemoveChild(tree, path, path_index, level - 1);
+    }
+}
+
+/*
+ * Move `count` rows starting at slot `from` of leaf `src` to slot `to` of leaf `dst`, the ranges may overlap
+ */
+void rowLeafMove(rowLeaf *dst, int to, rowLeaf *src, int from, int count) {
+    memmove(&dst->size[to], &src->size[from], sizeof(int) * count);
+    memmove(&dst->renderSize[to], &src->renderSize[from], sizeof(int) * count);
+    memmove(&dst->open_comment[to], &src->open_comment[from], sizeof(bool) * count);
+    memmove(&dst->mapped[to], &src->mapped[from], sizeof(bool) * count);
+    memmove(&dst->shared[to], &src->shared[from], sizeof(bool) * count);
+    memmove(&dst->chars[to], &src->chars[from], sizeof(char *) * count);
+    memmove(&dst->render[to], &src->render[from], sizeof(char *) * count);
+    memmove(&dst->highlight[to], &src->highlight[from], sizeof(unsigned char *) * count);
+}
+
+/*
+ * Return the row at index `at`, ROW_NONE if `at` is outside the tree
+ */
+erow rowTreeGet(rowTree *tree, int at) {
+    if (at < 0 || at >= tree->count) {
+        return ROW_NONE;
+    }
+
+    int slot;
+    rowLeaf *leaf = rowNodeFind(tree->root, tree->height, at, &slot);
+
+    return (erow){leaf, slot};
+}
+
+/*
+ * Return the row at index `at` after copying the nodes above it that a snapshot reads, so its fields can be modified.
+ * Other rows are invalidated.
+ */
+erow rowTreeMakeWritable(rowTree *tree, int at) {
+    if (at < 0 || at >= tree->count) {
+        return ROW_NONE;
+    }
+
+    int slot;
+    rowLeaf *leaf = rowTreeDescend(tree, at, &slot, NULL, NULL, 0, 0);
+
+    return (erow){leaf, slot};
+}
+
+/*
+ * Returns `true` if the characters of `row` may be read by a snapshot, so they must be copied before they are modified
+ * and freed only once the snapshot is released
+ */
+bool rowTreeRowShared(rowTree *tree, erow row) {
+    // Rows of copied leaves are marked, the marks only matter while there is a snapshot
+    return rowTreeFrozen(tree, row.leaf->epoch) || (tree->frozen != 0 && ROW_SHARED(row));
+}
+
+/*
+ * Make space for a row of `size` characters at index `at` and return it.
+ * Only the size of the returned row is set. Other rows are invalidated.
+ */
+erow rowTreeInsert(rowTree *tree, int at, int size) {
+    if (at < 0 || at > tree->count) {
+        return ROW_NONE;
+    }
+
+    // Create the first leaf
+    if (tree->root == NULL) {
+        rowLeaf *leaf = malloc(sizeof(rowLeaf));
+        leaf->count = 0;
+        leaf->epoch = tree->epoch;
+        leaf->prev = NULL;
+        leaf->next = NULL;
+
+        rowNode *root = malloc(sizeof(rowNode));
+        root->count = 1;
+        root->epoch = tree->epoch;
+        root->child[0] = leaf;
+        root->rows[0] = 0;
+        root->bytes[0] = 0;
+
+        tree->root = root;
+        tree->height = 1;
+        tree->first = leaf;
+    }
+
+    rowNode *path[ROW_TREE_MAX_HEIGHT];
+    int path_index[ROW_TREE_MAX_HEIGHT];
+    int slot;
+    rowLeaf *leaf = rowTreeDescend(tree, at, &slot, path, path_index, 1, size + 1);
+
+    if (leaf->count == ROW_LEAF_MAX) {
+        // Appending at the end of a leaf (e.g. while loading a file) keeps the leaf full,
+        // otherwise split the leaf in half
+        int half = (slot == leaf->count) ? leaf->count : leaf->count / 2;
+
+        rowLeaf *right = malloc(sizeof(rowLeaf));
+        right->count = leaf->count - half;
+        right->epoch = tree->epoch;
+        rowLeafMove(right, 0, leaf, half, right->count);
+        leaf->count = half;
+
+        right->prev = leaf;
+        right->next = leaf->next;
+        if (leaf->next) {
+            leaf->next->prev = right;
+        }
+        leaf->next = right;
+
+        int left_rows = leaf->count;
+        long left_bytes = rowLeafBytes(leaf, leaf->count);
+        int right_rows = right->count;
+        long right_bytes = rowLeafBytes(right, right->count);
+
+        if (slot > half || half == ROW_LEAF_MAX) {
+            slot -= half;
+            leaf = right;
+            right_rows++;
+            right_bytes += size + 1;
+        } else {
+            left_rows++;
+            left_bytes += size + 1;
+        }
+
+        rowTreeInsertSibling(tree, path, path_index, tree->height - 1, right,
+                             left_rows, left_bytes, right_rows, right_bytes);
+    }
+
+    // Move the rows after `slot` one spot to make space for the new row
+    rowLeafMove(leaf, slot + 1, leaf, slot, leaf->count - slot);
+    leaf->count++;
+    tree->count++;
+
+    leaf->size[slot] = size;
+
+    return (erow){leaf, slot};
+}
+
+/*
+ * Remove the row at index `at` from the tree.
+ * The row's memory should be freed by the caller beforehand. Other rows are invalidated.
+ */
+void rowTreeDelete(rowTree *tree, int at) {
+    if (at < 0 || at >= tree->count) {
+        return;
+    }
+
+    long bytes = ROW_SIZE(rowTreeGet(tree, at)) + 1;
+
+    rowNode *path[ROW_TREE_MAX_HEIGHT];
+    int path_index[ROW_TREE_MAX_HEIGHT];
+    int slot;
+    rowLeaf *leaf = rowTreeDescend(tree, at, &slot, path, path_index, -1, -bytes);
+
+    rowLeafMove(leaf, slot, leaf, slot + 1, leaf->count - slot - 1);
+    leaf->count--;
+    tree->count--;
+
+    int level = tree->height - 1;
+    rowNode *parent = path[level];
+    int i = path_index[level];
+
+    // Merge with the next leaf when both are small, so deletes don't leave many tiny leaves behind
+    rowLeaf *removed = NULL;
+    if (leaf->count == 0) {
+        removed = leaf;
+    } else if (i + 1 < parent->count) {
+        rowLeaf *next = parent->child[i + 1];
+
+        if (leaf->count + next->count <= ROW_LEAF_MAX / 2) {
+            rowLeafMove(leaf, leaf->count, next, 0, next->count);
+
+            // A snapshot reading the next leaf keeps reading the characters of its rows
+            if (rowTreeFrozen(tree, next->epoch)) {
+                memset(&leaf->shared[leaf->count], true, sizeof(bool) * next->count);
+            }
+
+            leaf->count += next->count;
+            parent->rows[i] += parent->rows[i + 1];
+            parent->bytes[i] += parent->bytes[i + 1];
+
+            removed = next;
+            path_index[level] = i + 1;
+        }
+    }
+
+    if (removed) {
+        if (removed->prev) {
+            removed->prev->next = removed->next;
+        } else {
+            tree->first = removed->next;
+        }
+
+        if (removed->next) {
+            removed->next->prev = removed->prev;
+        }
+
+        rowTreeRetire(tree, removed, removed->epoch);
+        rowTreeRemoveChild(tree, path, path_index, level);
+    }
+
+    // Shrink the tree while the root only has a single inner node below it
+    while (tree->height > 1 && tree->root->count == 1) {
+        rowNode *old_root = tree->root;
+        tree->root = old_root->child[0];
+        tree->height--;
+        free(old_root);
+    }
+}
+
+/*
+ * Record that the size of the row at index `at` changes by `delta`
+ */
+void rowTreeAddBytes(rowTree *tree, int at, int delta) {
+    if (at < 0 || at >= tree->count) {
+        return;
+    }
+
+    int slot;
+    rowTreeDescend(tree, at, &slot, NULL, NULL, 0, delta);
+}
+
+/*
+ * Return the byte offset of the start of the row at index `at`, counting a newline after each row.
+ * Passing the number of rows returns the total size of the buffer.
+ */
+long rowTreeByteOffset(rowTree *tree, int at) {
+    if (tree->root == NULL || at <= 0) {
+        return 0;
+    }
+
+    if (at > tree->count) {
+        at = tree->count;
+    }
+
+    long byte = 0;
+    void *node = tree->root;
+
+    for (int level = 0; level < tree->height; level++) {
+        rowNode *inner = node;
+
+        // Add the bytes of all children before the one containing the row
+        int i = 0;
+        while (i < inner->count - 1 && at >= inner->rows[i]) {
+            at -= inner->rows[i];
+            byte += inner->bytes[i];
+            i++;
+        }
+
+        node = inner->child[i];
+    }
+
+    return byte + rowLeafBytes(node, at);
+}
+
+/*
+ * Return the index of the row containing byte offset `byte`.
+ * Stores the byte offset of the start of that row in `row_start`.
+ * Offsets past the end belong to the last row.
+ */
+int rowTreeRowAtByte(rowTree *tree, long byte, long *row_start) {
+    *row_start = 0;
+
+    if (tree->root == NULL) {
+        return 0;
+    }
+
+    int row;
+    long start;
+    rowLeaf *leaf = rowNodeFindByte(tree->root, tree->height, byte, &start, &row);
+
+    int slot = 0;
+    while (slot < leaf->count - 1 && byte >= start + leaf->size[slot] + 1) {
+        start += leaf->size[slot] + 1;
+        slot++;
+    }
+
+    *row_start = start;
+    return row + slot;
+}
+
+/*
+ * Free inner node `node` at `level` levels above the leaves, including everything below it.
+ * Nodes a snapshot reads are kept until it is released.
+ */
+void rowNodeFree(rowTree *tree, void *node, int level) {
+    if (level > 0) {
+        rowNode *inner = node;
+        for (int i = 0; i < inner->count; i++) {
+            rowNodeFree(tree, inner->child[i], level - 1);
+        }
+
+        rowTreeRetire(tree, inner, inner->epoch);
+    } else {
+        rowLeaf *leaf = node;
+        rowTreeRetire(tree, leaf, leaf->epoch);
+    }
+}
+
+/*
+ * Free all nodes of the tree (not the memory owned by the rows)
+ */
+void rowTreeFree(rowTree *tree) {
+    if (tree->root) {
+        rowNodeFree(tree, tree->root, tree->height);
+    }
+
+    tree->root = NULL;
+    tree->height = 0;
+    tree->count = 0;
+    tree->first = NULL;
+}
+
+/*
+ * Store a read only view of the current rows in `snapshot`, in O(1).
+ * The nodes of the tree are copied before they are modified from now on, until the snapshot is released.
+ */
+void rowTreeSnapshot(rowTree *tree, rowSnapshot *snapshot) {
+    snapshot->root = tree->root;
+    snapshot->height = tree->height;
+    snapshot->count = tree->count;
+    snapshot->bytes = rowTreeByteOffset(tree, tree->count);
+    snapshot->epoch = tree->epoch;
+
+    if (tree->snapshotCount == tree->snapshotCapacity) {
+        tree->snapshotCapacity = tree->snapshotCapacity ? tree->snapshotCapacity * 2 : 4;
+        tree->snapshots = realloc(tree->snapshots, sizeof(int) * tree->snapshotCapacity);
+    }
+
+    tree->snapshots[tree->snapshotCount++] = tree->epoch;
+
+    // Everything created so far is read by the snapshot
+    tree->epoch++;
+    tree->frozen = tree->epoch;
+}
+
+/*
+ * Release `snapshot`, freeing the nodes that were replaced while it was used and no other snapshot reads
+ */
+void rowTreeReleaseSnapshot(rowTree *tree, rowSnapshot *snapshot) {
+    int i = 0;
+    while (i < tree->snapshotCount && tree->snapshots[i] != snapshot->epoch) {
+        i++;
+    }
+
+    if (i == tree->snapshotCount) {
+        return;
+    }
+
+    memmove(&tree->snapshots[i], &tree->snapshots[i + 1], sizeof(int) * (tree->snapshotCount - i - 1));
+    tree->snapshotCount--;
+
+    // Only nodes the newest remaining snapshot reads are still frozen
+    tree->frozen = tree->snapshotCount > 0 ? tree->snapshots[tree->snapshotCount - 1] + 1 : 0;
+
+    // Nodes are retired in epoch order, the ones replaced before the oldest remaining snapshot was taken are unused
+    int oldest = rowTreeOldestSnapshot(tree);
+    int freed = 0;
+    while (freed < tree->retiredCount && tree->retired[freed].epoch <= oldest) {
+        free(tree->retired[freed].node);
+        freed++;
+    }
+
+    memmove(tree->retired, &tree->retired[freed], sizeof(rowRetired) * (tree->retiredCount - freed));
+    tree->retiredCount -= freed;
+}
+
+/*
+ * Return the epoch of the oldest snapshot that was not released, the current epoch if there is none.
+ * Memory replaced at an epoch up to the returned one is not read by any snapshot.
+ */
+int rowTreeOldestSnapshot(rowTree *tree) {
+    return tree->snapshotCount > 0 ? tree->snapshots[0] : tree->epoch;
+}
+
+/*
+ * Return the leaf of `snapshot` containing the row at index `at`, and the position of the row in the leaf in `slot`
+ */
+rowLeaf *rowSnapshotLeaf(const rowSnapshot *snapshot, int at, int *slot) {
+    return rowNodeFind(snapshot->root, snapshot->height, at, slot);
+}
+
+/*
+ * Return the leaf of `snapshot` containing byte offset `byte`, and the byte offset of its first row in `start`.
+ * Offsets past the end belong to the last leaf.
+ */
+rowLeaf *rowSnapshotLeafAtByte(const rowSnapshot *snapshot, long byte, long *start) {
+    int row;
+    return rowNodeFindByte(snapshot->root, snapshot->height, byte, start, &row);
+}
+
+/*
+ * Position iterator `it` at the row at index `at`
+ */
+void rowTreeIterate(rowTree *tree, int at, rowIterator *it) {
+    it->leaf = NULL;
+    it->slot = 0;
+
+    if (at < 0 || at >= tree->count) {
+        return;
+    }
+
+    it->leaf = rowNodeFind(tree->root, tree->height, at, &it->slot);
+}
+
+/*
+ * Return the row at the iterator's position and advance it, ROW_NONE when past the last row
+ */
+erow rowIteratorNext(rowIterator *it) {
+    while (it->leaf && it->slot >= it->leaf->count) {
+        it->leaf = it->leaf->next;
+        it->slot = 0;
+    }
+
+    if (it->leaf == NULL) {
+        return ROW_NONE;
+    }
+
+    return (erow){it->leaf, it->slot++};
+}
+
+/*
+ * Advance iterator `it` by `count` rows, skipping whole leaves at once
+ */
+void rowIteratorSkip(rowIterator *it, int count) {
+    while (it->leaf && it->slot + count >= it->leaf->count) {
+        count -= it->leaf->count - it->slot;
+        it->leaf = it->leaf->next;
+        it->slot = 0;
+    }
+
+    if (it->leaf) {
+        it->slot += count;
+    }
+}
@@ -0,0 +1,247 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stdbool.h>
+
+/*
+ * Maximum number of rows stored in a single leaf of the row tree
+ */
+#define ROW_LEAF_MAX 64
+
+/*
+ * Maximum number of children of an inner node of the row tree
+ */
+#define ROW_NODE_MAX 32
+
+/*
+ * Maximum height of the row tree, ROW_NODE_MAX^16 rows is more than enough
+ */
+#define ROW_TREE_MAX_HEIGHT 16
+
+/*
+ * Leaf of the row tree, stores a run of consecutive rows.
+ * Leaves are linked so the rows can be walked in order without going through the inner nodes.
+ * The fields of the rows are stored in parallel arrays (structure of arrays),
+ * so scans over e.g. the row sizes read dense memory.
+ */
+typedef struct rowLeaf {
+    int count;
+    // Epoch of the tree when the leaf was created, the leaf is copied before it is modified if a snapshot reads it
+    int epoch;
+    struct rowLeaf *prev;
+    struct rowLeaf *next;
+
+    int size[ROW_LEAF_MAX];
+    int renderSize[ROW_LEAF_MAX];
+    bool open_comment[ROW_LEAF_MAX];
+    // Set when `chars` points into the memory mapped file, the row is copied before it is modified
+    bool mapped[ROW_LEAF_MAX];
+    // Set when `chars` may be read by a snapshot of the tree (see rowTreeRowShared), the row is copied before it is modified
+    bool shared[ROW_LEAF_MAX];
+
+    char *chars[ROW_LEAF_MAX];
+    char *render[ROW_LEAF_MAX];
+    unsigned char *highlight[ROW_LEAF_MAX];
+} rowLeaf;
+
+/*
+ * A row in the editor: the leaf storing the row and its slot in the leaf.
+ * The fields of the row are accessed with the ROW_* macros.
+ * Like pointers, rows are invalidated when rows are inserted or deleted.
+ */
+typedef struct erow {
+    rowLeaf *leaf;
+    int slot;
+} erow;
+
+/*
+ * Row returned for indexes outside the tree, check with ROW_EXISTS
+ */
+#define ROW_NONE ((erow){NULL, 0})
+
+#define ROW_EXISTS(row) ((row).leaf != NULL)
+#define ROW_SIZE(row) ((row).leaf->size[(row).slot])
+#define ROW_CHARS(row) ((row).leaf->chars[(row).slot])
+#define ROW_RENDER_SIZE(row) ((row).leaf->renderSize[(row).slot])
+#define ROW_RENDER(row) ((row).leaf->render[(row).slot])
+#define ROW_HIGHLIGHT(row) ((row).leaf->highlight[(row).slot])
+#define ROW_OPEN_COMMENT(row) ((row).leaf->open_comment[(row).slot])
+#define ROW_MAPPED(row) ((row).leaf->mapped[(row).slot])
+#define ROW_SHARED(row) ((row).leaf->shared[(row).slot])
+
+/*
+ * Inner node of the row tree.
+ * Stores the number of rows and bytes (including newlines) below each child,
+ * so a row can be found by its index or by a byte offset.
+ */
+typedef struct rowNode {
+    int count;
+    // Epoch of the tree when the node was created (see rowLeaf)
+    int epoch;
+    void *child[ROW_NODE_MAX];
+    int rows[ROW_NODE_MAX];
+    long bytes[ROW_NODE_MAX];
+} rowNode;
+
+/*
+ * Node or leaf replaced by a copy while a snapshot may still read it
+ */
+typedef struct rowRetired {
+    void *node;
+    // Epoch of the tree when the node was replaced
+    int epoch;
+} rowRetired;
+
+/*
+ * Balanced tree (B+ tree) of rows.
+ * Finding, inserting and deleting a row at any index is O(log n),
+ * as is converting between row indexes and byte offsets.
+ *
+ * The tree is persistent: a snapshot only keeps the root, and nodes and leaves a snapshot reads
+ * are copied (with the path above them) before they are modified. Taking a snapshot is O(1)
+ * and every modification copies O(log n) nodes, so snapshots cost time proportional to the edits.
+ */
+typedef struct rowTree {
+    rowNode *root;
+    // Number of inner node levels above the leaves (0 when the tree is empty)
+    int height;
+    // Total number of rows
+    int count;
+    rowLeaf *first;
+
+    // Epoch of the nodes created now, incremented by every snapshot
+    int epoch;
+    // Nodes created before this epoch may be read by a snapshot, 0 when there is no snapshot
+    int frozen;
+
+    // Epochs of the snapshots that were not released yet, oldest first
+    int *snapshots;
+    int snapshotCount;
+    int snapshotCapacity;
+
+    // Nodes replaced by copies, freed once the snapshots that read them are released
+    rowRetired *retired;
+    int retiredCount;
+    int retiredCapacity;
+} rowTree;
+
+/*
+ * Read only view of the rows of a tree when the snapshot was taken.
+ * It stays valid while the tree is modified, until it is released with rowTreeReleaseSnapshot.
+ * Snapshots can be read by other threads, but only through the inner nodes: the links between leaves are not frozen.
+ */
+typedef struct rowSnapshot {
+    void *root;
+    int height;
+    int count;
+    // Size of the rows, counting a newline after each row
+    long bytes;
+    int epoch;
+} rowSnapshot;
+
+/*
+ * Position in the row tree, used to walk the rows in order
+ */
+typedef struct rowIterator {
+    rowLeaf *leaf;
+    int slot;
+} rowIterator;
+
+#define ROW_TREE_INIT {NULL, 0, 0, NULL, 0, 0, NULL, 0, 0, NULL, 0, 0}
+
+/*
+ * Return the row at index `at`, ROW_NONE if `at` is outside the tree
+ */
+erow rowTreeGet(rowTree *tree, int at);
+
+/*
+ * Make space for a row of `size` characters at index `at` and return it.
+ * Only the size of the returned row is set. Other rows are invalidated.
+ */
+erow rowTreeInsert(rowTree *tree, int at, int size);
+
+/*
+ * Return the row at index `at` after copying the nodes above it that a snapshot reads, so its fields can be modified.
+ * Other rows are invalidated.
+ */
+erow rowTreeMakeWritable(rowTree *tree, int at);
+
+/*
+ * Returns `true` if the characters of `row` may be read by a snapshot, so they must be copied before they are modified
+ * and freed only once the snapshot is released
+ */
+bool rowTreeRowShared(rowTree *tree, erow row);
+
+/*
+ * Remove the row at index `at` from the tree.
+ * The row's memory should be freed by the caller beforehand. Other rows are invalidated.
+ */
+void rowTreeDelete(rowTree *tree, int at);
+
+/*
+ * Record that the size of the row at index `at` changes by `delta`
+ */
+void rowTreeAddBytes(rowTree *tree, int at, int delta);
+
+/*
+ * Return the byte offset of the start of the row at index `at`, counting a newline after each row.
+ * Passing the number of rows returns the total size of the buffer.
+ */
+long rowTreeByteOffset(rowTree *tree, int at);
+
+/*
+ * Return the index of the row containing byte offset `byte`.
+ * Stores the byte offset of the start of that row in `row_start`.
+ * Offsets past the end belong to the last row.
+ */
+int rowTreeRowAtByte(rowTree *tree, long byte, long *row_start);
+
+/*
+ * Free all nodes of the tree (not the memory owned by the rows)
+ */
+void rowTreeFree(rowTree *tree);
+
+/*
+ * Store a read only view of the current rows in `snapshot`, in O(1).
+ * The nodes of the tree are copied before they are modified from now on, until the snapshot is released.
+ */
+void rowTreeSnapshot(rowTree *tree, rowSnapshot *snapshot);
+
+/*
+ * Release `snapshot`, freeing the nodes that were replaced while it was used and no other snapshot reads
+ */
+void rowTreeReleaseSnapshot(rowTree *tree, rowSnapshot *snapshot);
+
+/*
+ * Return the epoch of the oldest snapshot that was not released, the current epoch if there is none.
+ * Memory replaced at an epoch up to the returned one is not read by any snapshot.
+ */
+int rowTreeOldestSnapshot(rowTree *tree);
+
+/*
+ * Return the leaf of `snapshot` containing the row at index `at`, and the position of the row in the leaf in `slot`
+ */
+rowLeaf *rowSnapshotLeaf(const rowSnapshot *snapshot, int at, int *slot);
+
+/*
+ * Return the leaf of `snapshot` containing byte offset `byte`, and the byte offset of its first row in `start`.
+ * Offsets past the end belong to the last leaf.
+ */
+rowLeaf *rowSnapshotLeafAtByte(const rowSnapshot *snapshot, long byte, long *start);
+
+/*
+ * Position iterator `it` at the row at index `at`
+ */
+void rowTreeIterate(rowTree *tree, int at, rowIterator *it);
+
+/*
+ * Return the row at the iterator's position and advance it, ROW_NONE when past the last row
+ */
+erow rowIteratorNext(rowIterator *it);
+
+/*
+ * Advance iterator `it` by `count` rows, skipping whole leaves at once
+ */
+void rowIteratorSkip(rowIterator *it, int count);
+
+#endif
@@ -0,0 +1,1310 @@
+#include "dfa.h"
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Set of bytes matched by one character of the pattern, one bit per byte
+ */
+struct editorByteSet {
+    uint8_t bits[32];
+};
+
+/*
+ * Parsed pattern, the nodes of a tree stored in an array
+ */
+enum editorRegexNodeType {
+    NODE_EMPTY,
+    // A byte of `set`
+    NODE_SET,
+    NODE_LINE_START,
+    NODE_LINE_END,
+    // `left` followed by `right`
+    NODE_CONCAT,
+    // `left` or `right`
+    NODE_ALTERNATE,
+    // `left` repeated `min` up to `max` times, -1 for no limit
+    NODE_REPEAT,
+};
+
+struct editorRegexNode {
+    enum editorRegexNodeType type;
+    int left;
+    int right;
+    int min;
+    int max;
+    int set;
+    // The node compiles to no instructions, it only matches the empty string anywhere (e.g. "()" or "(){3}")
+    bool no_code;
+};
+
+/*
+ * Instructions of a compiled pattern (a Thompson NFA). Instructions continue at `x`, splits also at `y`.
+ */
+enum editorRegexOp {
+    // Consume a byte of set `set`
+    OP_BYTE,
+    OP_SPLIT,
+    OP_JUMP,
+    // Only continue where the scan begins (the start of the line when scanning forwards)
+    OP_BEGIN,
+    // Only continue where the scan ends (the end of the line when scanning forwards)
+    OP_END,
+    OP_MATCH,
+};
+
+struct editorRegexInstruction {
+    enum editorRegexOp op;
+    int x;
+    int y;
+    int set;
+};
+
+struct editorRegexProgram {
+    struct editorRegexInstruction *code;
+    int count;
+    int capacity;
+};
+
+struct editorRegex {
+    // Program of the pattern and program of the reversed pattern, for scanning backwards
+    struct editorRegexProgram forward;
+    struct editorRegexProgram backward;
+
+    // Byte sets of the OP_BYTE instructions
+    struct editorByteSet *sets;
+    int set_count;
+
+    // Bytes that are in the same sets share a class, the DFA states have a transition per class
+    uint8_t classes[256];
+    int class_count;
+    // A byte of each class
+    uint8_t class_bytes[256];
+};
+
+/*
+ * State of the parser, nodes are added while the pattern is read
+ */
+struct editorRegexParser {
+    const char *pattern;
+    size_t len;
+    size_t pos;
+
+    struct editorRegexNode *nodes;
+    int count;
+    int capacity;
+
+    struct editorRegex *regex;
+    const char *error;
+};
+
+/*
+ * DFA state: the set of NFA instructions the scan can be at, stored in the pool of the DFA
+ */
+struct editorDfaState {
+    int offset;
+    int len;
+    // The pattern matched
+    bool accept;
+    // The pattern matched if the scan ends here (through OP_END)
+    bool accept_end;
+};
+
+/*
+ * DFA of a program, its states and transitions are built the first time a scan needs them
+ */
+struct editorDfa {
+    const struct editorRegex *regex;
+    const struct editorRegexProgram *program;
+    // Start the program again at every byte, so the scan finds matches starting anywhere before it
+    bool unanchored;
+
+    struct editorDfaState *states;
+    int count;
+    int capacity;
+
+    // Instructions of all states
+    int *pool;
+    int pool_len;
+    int pool_capacity;
+
+    // Next state of every state and byte class, -1 while it was not built yet
+    int *next;
+
+    // Open addressing table of the states by their instructions, -1 for free slots
+    int *table;
+
+    // Start state where the scan begins at the edge of the line and elsewhere, -1 while it was not built yet
+    int start[2];
+
+    // Number of times all states were dropped
+    int flushes;
+
+    // Instructions a scan starting at a byte other than the first begins with, for `unanchored` scans
+    int *restart;
+    int restart_len;
+
+    // Instructions of the state being built, `marks` equal to `mark` for the instructions in it
+    int *build;
+    int build_len;
+    int *stack;
+    int *marks;
+    int mark;
+};
+
+struct editorRegexMatcher {
+    // Finds the end of the longest match starting at a position
+    struct editorDfa forward;
+    // Finds the positions matches start at, scanning the line backwards
+    struct editorDfa backward;
+
+    // Line whose match starts are in `starts`, it is set for every position a non-empty match starts at
+    const char *line;
+    int line_size;
+    char *starts;
+    int starts_capacity;
+};
+
+/*** byte sets ***/
+
+void editorByteSetAdd(struct editorByteSet *set, int byte) {
+    set->bits[byte >> 3] |= 1 << (byte & 7);
+}
+
+bool editorByteSetHas(const struct editorByteSet *set, int byte) {
+    return set->bits[byte >> 3] & (1 << (byte & 7));
+}
+
+void editorByteSetAddRange(struct editorByteSet *set, int first, int last) {
+    for (int byte = first; byte <= last; byte++) {
+        editorByteSetAdd(set, byte);
+    }
+}
+
+/*
+ * Add the bytes for which `is` returns non-zero (a <ctype.h> classifier) to `set`, or the other bytes if `negate`
+ */
+void editorByteSetAddClass(struct editorByteSet *set, int (*is)(int), bool negate) {
+    for (int byte = 0; byte < 256; byte++) {
+        if ((is(byte) != 0) != negate) {
+            editorByteSetAdd(set, byte);
+        }
+    }
+}
+
+int editorIsWord(int c) {
+    return isalnum(c) || c == '_';
+}
+
+/*
+ * Named classes of bracket expressions, e.g. [[:alpha:]]
+ */
+struct editorRegexClassName {
+    const char *name;
+    int (*is)(int);
+};
+
+struct editorRegexClassName regexClassNames[] = {
+    { "alnum", isalnum },
+    { "alpha", isalpha },
+    { "blank", isblank },
+    { "cntrl", iscntrl },
+    { "digit", isdigit },
+    { "graph", isgraph },
+    { "lower", islower },
+    { "print", isprint },
+    { "punct", ispunct },
+    { "space", isspace },
+    { "upper", isupper },
+    { "xdigit", isxdigit },
+    { "word", editorIsWord },
+    { NULL, NULL },
+};
+
+/*** parser ***/
+
+/*
+ * Add a node to the parsed pattern, returns its index
+ */
+int editorRegexAddNode(struct editorRegexParser *parser, enum editorRegexNodeType type, int left, int right) {
+    if (parser->count == parser->capacity) {
+        parser->capacity = parser->capacity ? parser->capacity * 2 : 16;
+        parser->nodes = realloc(parser->nodes, sizeof(struct editorRegexNode) * parser->capacity);
+    }
+
+    struct editorRegexNode *node = &parser->nodes[parser->count];
+    node->type = type;
+    node->left = left;
+    node->right = right;
+    node->min = 0;
+    node->max = 0;
+    node->set = -1;
+
+    // Alternations compile to a split even if both sides are empty, repetitions to their repeated node
+    if (type == NODE_EMPTY) {
+        node->no_code = true;
+    } else if (type == NODE_CONCAT) {
+        node->no_code = parser->nodes[left].no_code && parser->nodes[right].no_code;
+    } else if (type == NODE_REPEAT) {
+        node->no_code = parser->nodes[left].no_code;
+    } else {
+        node->no_code = false;
+    }
+
+    return parser->count++;
+}
+
+/*
+ * Add an empty byte set to the compiled pattern, returns its index
+ */
+int editorRegexAddSet(struct editorRegex *regex) {
+    regex->sets = realloc(regex->sets, sizeof(struct editorByteSet) * (regex->set_count + 1));
+    memset(&regex->sets[regex->set_count], 0, sizeof(struct editorByteSet));
+
+    return regex->set_count++;
+}
+
+/*
+ * Returns `true` if the parser is at the end of the pattern
+ */
+bool editorRegexAtEnd(struct editorRegexParser *parser) {
+    return parser->pos >= parser->len;
+}
+
+/*
+ * Returns -1 after setting the parse error to `error`
+ */
+int editorRegexFail(struct editorRegexParser *parser, const char *error) {
+    parser->error = error;
+    return -1;
+}
+
+/*
+ * Return the value of hexadecimal digit `c`, -1 if it is not one
+ */
+int editorHexValue(int c) {
+    if (isdigit(c)) {
+        return c - '0';
+    }
+
+    if (isxdigit(c)) {
+        return tolower(c) - 'a' + 10;
+    }
+
+    return -1;
+}
+
+/*
+ * Parse the escape sequence after a '\' into `set`. Returns the escaped byte, -2 for a class escape (e.g. \d)
+ * or -1 on errors.
+ */
+int editorRegexParseEscape(struct editorRegexParser *parser, struct editorByteSet *set) {
+    if (editorRegexAtEnd(parser)) {
+        return editorRegexFail(parser, "trailing backslash");
+    }
+
+    char c = parser->pattern[parser->pos++];
+
+    switch (c) {
+        case 'd':
+        case 'D':
+            editorByteSetAddClass(set, isdigit, c == 'D');
+            return -2;
+        case 'w':
+        case 'W':
+            editorByteSetAddClass(set, editorIsWord, c == 'W');
+            return -2;
+        case 's':
+        case 'S':
+            editorByteSetAddClass(set, isspace, c == 'S');
+            return -2;
+        case 't':
+            c = '\t';
+            break;
+        case 'n':
+            c = '\n';
+            break;
+        case 'r':
+            c = '\r';
+            break;
+        case 'f':
+            c = '\f';
+            break;
+        case 'v':
+            c = '\v';
+            break;
+        case 'x': {
+            int high = parser->pos < parser->len ? editorHexValue(parser->pattern[parser->pos]) : -1;
+            int low = parser->pos + 1 < parser->len ? editorHexValue(parser->pattern[parser->pos + 1]) : -1;
+
+            if (high == -1 || low == -1) {
+                return editorRegexFail(parser, "invalid \\x escape");
+            }
+
+            parser->pos += 2;
+            c = high * 16 + low;
+            break;
+        }
+        default:
+            // Other letters and digits are reserved, e.g. for word boundaries and back references
+            if (isalnum(c)) {
+                return editorRegexFail(parser, "unsupported escape");
+            }
+            break;
+    }
+
+    editorByteSetAdd(set, (unsigned char)c);
+    return (unsigned char)c;
+}
+
+/*
+ * Parse a bracket expression after its '[' into a new byte set, returns the node or -1 on errors
+ */
+int editorRegexParseBracket(struct editorRegexParser *parser) {
+    struct editorByteSet set = { { 0 } };
+
+    bool negate = parser->pos < parser->len && parser->pattern[parser->pos] == '^';
+    if (negate) {
+        parser->pos++;
+    }
+
+    bool first = true;
+
+    while (true) {
+        if (editorRegexAtEnd(parser)) {
+            return editorRegexFail(parser, "missing ]");
+        }
+
+        char c = parser->pattern[parser->pos];
+
+        // A ']' at the start is part of the set
+        if (c == ']' && !first) {
+            parser->pos++;
+            break;
+        }
+
+        first = false;
+
+        // Named class, e.g. [:alpha:]
+        if (c == '[' && parser->pos + 1 < parser->len && parser->pattern[parser->pos + 1] == ':') {
+            const char *name = &parser->pattern[parser->pos + 2];
+            const char *name_end = NULL;
+
+            for (size_t i = parser->pos + 2; i + 1 < parser->len; i++) {
+                if (parser->pattern[i] == ':' && parser->pattern[i + 1] == ']') {
+                    name_end = &parser->pattern[i];
+                    break;
+                }
+            }
+
+            if (name_end == NULL) {
+                return editorRegexFail(parser, "missing :]");
+            }
+
+            int i = 0;
+            while (regexClassNames[i].name != NULL &&
+                   (strlen(regexClassNames[i].name) != (size_t)(name_end - name) ||
+                    strncmp(regexClassNames[i].name, name, name_end - name))) {
+                i++;
+            }
+
+            if (regexClassNames[i].name == NULL) {
+                return editorRegexFail(parser, "unknown class name");
+            }
+
+            editorByteSetAddClass(&set, regexClassNames[i].is, false);
+            parser->pos = name_end + 2 - parser->pattern;
+            continue;
+        }
+
+        // A single byte, which may start a range
+        int low;
+        parser->pos++;
+
+        if (c == '\\') {
+            low = editorRegexParseEscape(parser, &set);
+            if (low == -1) {
+                return -1;
+            } else if (low == -2) {
+                continue;
+            }
+        } else {
+            low = (unsigned char)c;
+            editorByteSetAdd(&set, low);
+        }
+
+        // A '-' before the closing ']' is part of the set
+        if (parser->pos + 1 < parser->len && parser->pattern[parser->pos] == '-' && parser->pattern[parser->pos + 1] != ']') {
+            parser->pos++;
+
+            int high;
+            c = parser->pattern[parser->pos++];
+
+            if (c == '\\') {
+                struct editorByteSet escaped = { { 0 } };
+                high = editorRegexParseEscape(parser, &escaped);
+                if (high == -1) {
+                    return -1;
+                } else if (high == -2) {
+                    return editorRegexFail(parser, "invalid range");
+                }
+            } else {
+                high = (unsigned char)c;
+            }
+
+            if (high < low) {
+                return editorRegexFail(parser, "invalid range");
+            }
+
+            editorByteSetAddRange(&set, low, high);
+        }
+    }
+
+    int node = editorRegexAddNode(parser, NODE_SET, -1, -1);
+    int index = editorRegexAddSet(parser->regex);
+
+    for (int i = 0; i < 32; i++) {
+        parser->regex->sets[index].bits[i] = negate ? ~set.bits[i] : set.bits[i];
+    }
+
+    parser->nodes[node].set = index;
+    return node;
+}
+
+int editorRegexParseAlternation(struct editorRegexParser *parser);
+
+/*
+ * Parse a character, a bracket expression, an anchor or a group, returns the node or -1 on errors
+ */
+int editorRegexParseAtom(struct editorRegexParser *parser) {
+    char c = parser->pattern[parser->pos++];
+
+    switch (c) {
+        case '(': {
+            // Groups do not capture, (?:...) is accepted as well
+            if (parser->pos + 1 < parser->len && parser->pattern[parser->pos] == '?' && parser->pattern[parser->pos + 1] == ':') {
+                parser->pos += 2;
+            }
+
+            int node = editorRegexParseAlternation(parser);
+            if (node == -1) {
+                return -1;
+            }
+
+            if (editorRegexAtEnd(parser) || parser->pattern[parser->pos] != ')') {
+                return editorRegexFail(parser, "missing )");
+            }
+
+            parser->pos++;
+            return node;
+        }
+        case '[':
+            return editorRegexParseBracket(parser);
+        case '^':
+            return editorRegexAddNode(parser, NODE_LINE_START, -1, -1);
+        case '$':
+            return editorRegexAddNode(parser, NODE_LINE_END, -1, -1);
+        case '*':
+        case '+':
+        case '?':
+            return editorRegexFail(parser, "nothing to repeat");
+        default: {
+            struct editorByteSet set = { { 0 } };
+
+            if (c == '.') {
+                editorByteSetAddRange(&set, 0, 255);
+            } else if (c == '\\') {
+                if (editorRegexParseEscape(parser, &set) == -1) {
+                    return -1;
+                }
+            } else {
+                editorByteSetAdd(&set, (unsigned char)c);
+            }
+
+            int node = editorRegexAddNode(parser, NODE_SET, -1, -1);
+            int index = editorRegexAddSet(parser->regex);
+            parser->regex->sets[index] = set;
+            parser->nodes[node].set = index;
+            return node;
+        }
+    }
+}
+
+/*
+ * Parse the number at the parser's position into `value`, returns `false` if there is none
+ */
+bool editorRegexParseNumber(struct editorRegexParser *parser, int *value) {
+    if (editorRegexAtEnd(parser) || !isdigit(parser->pattern[parser->pos])) {
+        return false;
+    }
+
+    *value = 0;
+    while (!editorRegexAtEnd(parser) && isdigit(parser->pattern[parser->pos])) {
+        if (*value <= REGEX_MAX_REPEAT) {
+            *value = *value * 10 + (parser->pattern[parser->pos] - '0');
+        }
+
+        parser->pos++;
+    }
+
+    return true;
+}
+
+/*
+ * Parse a counted repetition after its '{' into `min` and `max` (-1 for no limit).
+ * Returns `false` and leaves the position unchanged if the '{' does not start one, it is matched literally then.
+ */
+bool editorRegexParseCount(struct editorRegexParser *parser, int *min, int *max) {
+    size_t start = parser->pos;
+
+    if (!editorRegexParseNumber(parser, min)) {
+        parser->pos = start;
+        return false;
+    }
+
+    *max = *min;
+
+    if (!editorRegexAtEnd(parser) && parser->pattern[parser->pos] == ',') {
+        parser->pos++;
+
+        if (!editorRegexParseNumber(parser, max)) {
+            *max = -1;
+        }
+    }
+
+    if (editorRegexAtEnd(parser) || parser->pattern[parser->pos] != '}') {
+        parser->pos = start;
+        return false;
+    }
+
+    parser->pos++;
+    return true;
+}
+
+/*
+ * Parse an atom followed by any number of repetition operators, returns the node or -1 on errors
+ */
+int editorRegexParseRepeat(struct editorRegexParser *parser) {
+    int node;
+
+    // A '{' that does not start a counted repetition is a literal
+    if (parser->pattern[parser->pos] == '{') {
+        int min, max;
+        size_t start = parser->pos++;
+
+        if (editorRegexParseCount(parser, &min, &max)) {
+            return editorRegexFail(parser, "nothing to repeat");
+        }
+
+        parser->pos = start + 1;
+        node = editorRegexAddNode(parser, NODE_SET, -1, -1);
+        int index = editorRegexAddSet(parser->regex);
+        editorByteSetAdd(&parser->regex->sets[index], '{');
+        parser->nodes[node].set = index;
+    } else {
+        node = editorRegexParseAtom(parser);
+    }
+
+    while (node != -1 && !editorRegexAtEnd(parser)) {
+        int min, max;
+        char c = parser->pattern[parser->pos++];
+
+        if (c == '*') {
+            min = 0;
+            max = -1;
+        } else if (c == '+') {
+            min = 1;
+            max = -1;
+        } else if (c == '?') {
+            min = 0;
+            max = 1;
+        } else if (c == '{' && editorRegexParseCount(parser, &min, &max)) {
+            if (min > REGEX_MAX_REPEAT || max > REGEX_MAX_REPEAT) {
+                return editorRegexFail(parser, "repetition count too large");
+            }
+
+            if (max != -1 && max < min) {
+                return editorRegexFail(parser, "invalid repetition count");
+            }
+        } else {
+            parser->pos--;
+            break;
+        }
+
+        int repeat = editorRegexAddNode(parser, NODE_REPEAT, node, -1);
+        parser->nodes[repeat].min = min;
+        parser->nodes[repeat].max = max;
+        node = repeat;
+    }
+
+    return node;
+}
+
+/*
+ * Parse a sequence of repeated atoms up to a '|', a ')' or the end of the pattern, returns the node or -1 on errors
+ */
+int editorRegexParseConcat(struct editorRegexParser *parser) {
+    int node = editorRegexAddNode(parser, NODE_EMPTY, -1, -1);
+
+    while (!editorRegexAtEnd(parser) && parser->pattern[parser->pos] != '|' && parser->pattern[parser->pos] != ')') {
+        int next = editorRegexParseRepeat(parser);
+        if (next == -1) {
+            return -1;
+        }
+
+        node = editorRegexAddNode(parser, NODE_CONCAT, node, next);
+    }
+
+    return node;
+}
+
+/*
+ * Parse alternatives separated by '|', returns the node or -1 on errors
+ */
+int editorRegexParseAlternation(struct editorRegexParser *parser) {
+    int node = editorRegexParseConcat(parser);
+
+    while (node != -1 && !editorRegexAtEnd(parser) && parser->pattern[parser->pos] == '|') {
+        parser->pos++;
+
+        int next = editorRegexParseConcat(parser);
+        if (next == -1) {
+            return -1;
+        }
+
+        node = editorRegexAddNode(parser, NODE_ALTERNATE, node, next);
+    }
+
+    return node;
+}
+
+/*** compiler ***/
+
+/*
+ * Add an instruction continuing at the next instruction to `program`, returns its index or -1 if the program is full
+ */
+int editorRegexEmit(struct editorRegexProgram *program, enum editorRegexOp op, int set) {
+    if (program->count == REGEX_MAX_PROGRAM) {
+        return -1;
+    }
+
+    if (program->count == program->capacity) {
+        program->capacity = program->capacity ? program->capacity * 2 : 64;
+        program->code = realloc(program->code, sizeof(struct editorRegexInstruction) * program->capacity);
+    }
+
+    struct editorRegexInstruction *instruction = &program->code[program->count];
+    instruction->op = op;
+    instruction->x = program->count + 1;
+    instruction->y = -1;
+    instruction->set = set;
+
+    return program->count++;
+}
+
+/*
+ * Add the instructions of `node` to `program`. The `backward` program matches the reversed text,
+ * so sequences are reversed and the anchors swap places. Returns `false` if the program is full.
+ */
+bool editorRegexCompileNode(struct editorRegexProgram *program, const struct editorRegexNode *nodes, int node, bool backward) {
+    const struct editorRegexNode *n = &nodes[node];
+
+    switch (n->type) {
+        case NODE_EMPTY:
+            return true;
+        case NODE_SET:
+            return editorRegexEmit(program, OP_BYTE, n->set) != -1;
+        case NODE_LINE_START:
+            return editorRegexEmit(program, backward ? OP_END : OP_BEGIN, -1) != -1;
+        case NODE_LINE_END:
+            return editorRegexEmit(program, backward ? OP_BEGIN : OP_END, -1) != -1;
+        case NODE_CONCAT:
+            return editorRegexCompileNode(program, nodes, backward ? n->right : n->left, backward) &&
+                   editorRegexCompileNode(program, nodes, backward ? n->left : n->right, backward);
+        case NODE_ALTERNATE: {
+            int split = editorRegexEmit(program, OP_SPLIT, -1);
+            if (split == -1 || !editorRegexCompileNode(program, nodes, n->left, backward)) {
+                return false;
+            }
+
+            int jump = editorRegexEmit(program, OP_JUMP, -1);
+            if (jump == -1) {
+                return false;
+            }
+
+            program->code[split].y = program->count;
+
+            if (!editorRegexCompileNode(program, nodes, n->right, backward)) {
+                return false;
+            }
+
+            program->code[jump].x = program->count;
+            return true;
+        }
+        case NODE_REPEAT: {
+            // Repeating the empty string matches it once. Compiling the repetitions would not fill the program,
+            // so nested counts (e.g. "(){1000}{1000}{1000}") would compile for ages.
+            if (n->no_code) {
+                return true;
+            }
+
+            for (int i = 0; i < n->min; i++) {
+                if (!editorRegexCompileNode(program, nodes, n->left, backward)) {
+                    return false;
+                }
+            }
+
+            if (n->max == -1) {
+                // Loop: split into another repetition or past the loop
+                int split = editorRegexEmit(program, OP_SPLIT, -1);
+                if (split == -1 || !editorRegexCompileNode(program, nodes, n->left, backward)) {
+                    return false;
+                }
+
+                int jump = editorRegexEmit(program, OP_JUMP, -1);
+                if (jump == -1) {
+                    return false;
+                }
+
+                program->code[jump].x = split;
+                program->code[split].y = program->count;
+                return true;
+            }
+
+            // Optional repetitions, each split skips past all of them.
+            // The splits are chained through `y` until the end is known.
+            int pending = -1;
+            for (int i = n->min; i < n->max; i++) {
+                int split = editorRegexEmit(program, OP_SPLIT, -1);
+                if (split == -1) {
+                    return false;
+                }
+
+                program->code[split].y = pending;
+                pending = split;
+
+                if (!editorRegexCompileNode(program, nodes, n->left, backward)) {
+                    return false;
+                }
+            }
+
+            while (pending != -1) {
+                int previous = program->code[pending].y;
+                program->code[pending].y = program->count;
+                pending = previous;
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Compile the parsed pattern at `root` into `program`, returns `false` if the program is too large
+ */
+bool editorRegexCompileProgram(struct editorRegexProgram *program, const struct editorRegexNode *nodes, int root, bool backward) {
+    return editorRegexCompileNode(program, nodes, root, backward) && editorRegexEmit(program, OP_MATCH, -1) != -1;
+}
+
+/*
+ * Split the bytes into classes of bytes that are in exactly the same sets
+ */
+void editorRegexComputeClasses(struct editorRegex *regex) {
+    memset(regex->classes, 0, sizeof(regex->classes));
+    regex->class_count = 1;
+
+    for (int set = 0; set < regex->set_count; set++) {
+        // Split every class into the bytes in and the bytes not in the set
+        int split[2][256];
+        memset(split, -1, sizeof(split));
+
+        int count = 0;
+        for (int byte = 0; byte < 256; byte++) {
+            int *class = &split[editorByteSetHas(&regex->sets[set], byte)][regex->classes[byte]];
+
+            if (*class == -1) {
+                *class = count++;
+            }
+
+            regex->classes[byte] = *class;
+        }
+
+        regex->class_count = count;
+    }
+
+    for (int byte = 0; byte < 256; byte++) {
+        regex->class_bytes[regex->classes[byte]] = byte;
+    }
+}
+
+/*
+ * Compile the `len` characters of extended regular expression `pattern`.
+ * Supports literals, `.`, bracket expressions (with ranges and [:class:] names), \d \w \s (and their negations),
+ * grouping, alternation, `*`, `+`, `?` and `{m,n}` repetitions, and `^` and `$` anchoring at the line edges.
+ * Returns NULL and sets `error` to a description of the problem if the pattern is invalid.
+ */
+struct editorRegex *editorRegexCompile(const char *pattern, size_t len, const char **error) {
+    struct editorRegex *regex = calloc(1, sizeof(struct editorRegex));
+    struct editorRegexParser parser = { pattern, len, 0, NULL, 0, 0, regex, NULL };
+
+    int root = editorRegexParseAlternation(&parser);
+
+    // The alternation only stops early at an unmatched ')'
+    if (root != -1 && !editorRegexAtEnd(&parser)) {
+        root = editorRegexFail(&parser, "unmatched )");
+    }
+
+    if (root != -1 && (!editorRegexCompileProgram(&regex->forward, parser.nodes, root, false) ||
+                       !editorRegexCompileProgram(&regex->backward, parser.nodes, root, true))) {
+        root = editorRegexFail(&parser, "pattern too large");
+    }
+
+    free(parser.nodes);
+
+    if (root == -1) {
+        *error = parser.error;
+        editorRegexFree(regex);
+        return NULL;
+    }
+
+    editorRegexComputeClasses(regex);
+    return regex;
+}
+
+/*
+ * Free compiled regular expression `regex`, after all of its matchers were freed
+ */
+void editorRegexFree(struct editorRegex *regex) {
+    if (regex == NULL) {
+        return;
+    }
+
+    free(regex->forward.code);
+    free(regex->backward.code);
+    free(regex->sets);
+    free(regex);
+}
+
+/*** lazy DFA ***/
+
+void editorDfaNewMark(struct editorDfa *dfa);
+void editorDfaAddClosure(struct editorDfa *dfa, int pc, bool begin);
+
+void editorDfaInit(struct editorDfa *dfa, const struct editorRegex *regex, const struct editorRegexProgram *program,
+                   bool unanchored) {
+    memset(dfa, 0, sizeof(struct editorDfa));
+
+    dfa->regex = regex;
+    dfa->program = program;
+    dfa->unanchored = unanchored;
+
+    dfa->table = malloc(sizeof(int) * REGEX_MAX_STATES * 2);
+    memset(dfa->table, -1, sizeof(int) * REGEX_MAX_STATES * 2);
+    dfa->start[0] = -1;
+    dfa->start[1] = -1;
+
+    // Every instruction is pushed at most once while a state is built
+    dfa->build = malloc(sizeof(int) * program->count);
+    dfa->stack = malloc(sizeof(int) * program->count);
+    dfa->marks = calloc(program->count, sizeof(int));
+
+    if (unanchored) {
+        editorDfaNewMark(dfa);
+        dfa->build_len = 0;
+        editorDfaAddClosure(dfa, 0, false);
+
+        dfa->restart = malloc(sizeof(int) * dfa->build_len);
+        memcpy(dfa->restart, dfa->build, sizeof(int) * dfa->build_len);
+        dfa->restart_len = dfa->build_len;
+    }
+}
+
+void editorDfaFree(struct editorDfa *dfa) {
+    free(dfa->states);
+    free(dfa->pool);
+    free(dfa->next);
+    free(dfa->table);
+    free(dfa->restart);
+    free(dfa->build);
+    free(dfa->stack);
+    free(dfa->marks);
+}
+
+/*
+ * Start building a new state, no instruction is marked afterwards
+ */
+void editorDfaNewMark(struct editorDfa *dfa) {
+    if (dfa->mark == INT_MAX) {
+        memset(dfa->marks, 0, sizeof(int) * dfa->program->count);
+        dfa->mark = 0;
+    }
+
+    dfa->mark++;
+}
+
+/*
+ * Add the instructions reachable from instruction `pc` without consuming a byte to the state being built.
+ * Only instructions that wait for a byte or the end of the scan are kept, the others are followed.
+ * OP_BEGIN is only followed when `begin` is set.
+ */
+void editorDfaAddClosure(struct editorDfa *dfa, int pc, bool begin) {
+    const struct editorRegexInstruction *code = dfa->program->code;
+    int depth = 0;
+
+    if (dfa->marks[pc] != dfa->mark) {
+        dfa->marks[pc] = dfa->mark;
+        dfa->stack[depth++] = pc;
+    }
+
+    while (depth > 0) {
+        pc = dfa->stack[--depth];
+
+        int targets[2] = { -1, -1 };
+
+        switch (code[pc].op) {
+            case OP_BYTE:
+            case OP_END:
+            case OP_MATCH:
+                dfa->build[dfa->build_len++] = pc;
+                break;
+            case OP_SPLIT:
+                targets[0] = code[pc].x;
+                targets[1] = code[pc].y;
+                break;
+            case OP_JUMP:
+                targets[0] = code[pc].x;
+                break;
+            case OP_BEGIN:
+                if (begin) {
+                    targets[0] = code[pc].x;
+                }
+                break;
+        }
+
+        for (int i = 0; i < 2; i++) {
+            if (targets[i] != -1 && dfa->marks[targets[i]] != dfa->mark) {
+                dfa->marks[targets[i]] = dfa->mark;
+                dfa->stack[depth++] = targets[i];
+            }
+        }
+    }
+}
+
+/*
+ * Returns `true` if the state being built reaches OP_MATCH when the scan ends, by following its OP_END instructions
+ */
+bool editorDfaAcceptsAtEnd(struct editorDfa *dfa) {
+    const struct editorRegexInstruction *code = dfa->program->code;
+    int len = dfa->build_len;
+
+    // The instructions reached through OP_END are added after the state's own instructions, then dropped again.
+    // The state's own instructions are marked, so no instruction is added twice.
+    editorDfaNewMark(dfa);
+
+    for (int i = 0; i < len; i++) {
+        dfa->marks[dfa->build[i]] = dfa->mark;
+    }
+
+    for (int i = 0; i < len; i++) {
+        if (code[dfa->build[i]].op == OP_END) {
+            editorDfaAddClosure(dfa, code[dfa->build[i]].x, false);
+        }
+    }
+
+    // Instructions reached through OP_END may end the scan again (e.g. "$$")
+    for (int i = len; i < dfa->build_len; i++) {
+        if (code[dfa->build[i]].op == OP_END) {
+            editorDfaAddClosure(dfa, code[dfa->build[i]].x, false);
+        }
+    }
+
+    bool accept = false;
+    for (int i = len; i < dfa->build_len; i++) {
+        accept |= code[dfa->build[i]].op == OP_MATCH;
+    }
+
+    dfa->build_len = len;
+    return accept;
+}
+
+int editorCompareInts(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+/*
+ * Drop all states, scans continue from the state that is built next
+ */
+void editorDfaFlush(struct editorDfa *dfa) {
+    dfa->count = 0;
+    dfa->pool_len = 0;
+    dfa->start[0] = -1;
+    dfa->start[1] = -1;
+    dfa->flushes++;
+    memset(dfa->table, -1, sizeof(int) * REGEX_MAX_STATES * 2);
+}
+
+/*
+ * Return the state with the instructions of the state being built, adding it if it does not exist yet
+ */
+int editorDfaAddState(struct editorDfa *dfa) {
+    // States are found by their sorted instructions
+    qsort(dfa->build, dfa->build_len, sizeof(int), editorCompareInts);
+
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < dfa->build_len; i++) {
+        hash = (hash ^ (uint32_t)dfa->build[i]) * 16777619u;
+    }
+
+    int mask = REGEX_MAX_STATES * 2 - 1;
+    int slot = hash & mask;
+
+    while (dfa->table[slot] != -1) {
+        struct editorDfaState *state = &dfa->states[dfa->table[slot]];
+
+        if (state->len == dfa->build_len && !memcmp(&dfa->pool[state->offset], dfa->build, sizeof(int) * state->len)) {
+            return dfa->table[slot];
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    if (dfa->count == REGEX_MAX_STATES) {
+        editorDfaFlush(dfa);
+
+        slot = hash & mask;
+    }
+
+    int class_count = dfa->regex->class_count;
+
+    if (dfa->count == dfa->capacity) {
+        dfa->capacity = dfa->capacity ? dfa->capacity * 2 : 16;
+        dfa->states = realloc(dfa->states, sizeof(struct editorDfaState) * dfa->capacity);
+        dfa->next = realloc(dfa->next, sizeof(int) * dfa->capacity * class_count);
+    }
+
+    if (dfa->pool_len + dfa->build_len > dfa->pool_capacity) {
+        while (dfa->pool_len + dfa->build_len > dfa->pool_capacity) {
+            dfa->pool_capacity = dfa->pool_capacity ? dfa->pool_capacity * 2 : 256;
+        }
+
+        dfa->pool = realloc(dfa->pool, sizeof(int) * dfa->pool_capacity);
+    }
+
+    int index = dfa->count++;
+    struct editorDfaState *state = &dfa->states[index];
+
+    state->offset = dfa->pool_len;
+    state->len = dfa->build_len;
+    state->accept = false;
+    memcpy(&dfa->pool[state->offset], dfa->build, sizeof(int) * dfa->build_len);
+    dfa->pool_len += dfa->build_len;
+
+    for (int i = 0; i < dfa->build_len; i++) {
+        state->accept |= dfa->program->code[dfa->build[i]].op == OP_MATCH;
+    }
+
+    state->accept_end = state->accept || editorDfaAcceptsAtEnd(dfa);
+
+    memset(&dfa->next[index * class_count], -1, sizeof(int) * class_count);
+    dfa->table[slot] = index;
+
+    return index;
+}
+
+/*
+ * Return the state a scan starts in, `edge` is set when the scan starts at the edge of the line
+ */
+int editorDfaStart(struct editorDfa *dfa, bool edge) {
+    if (dfa->start[edge] == -1) {
+        editorDfaNewMark(dfa);
+        dfa->build_len = 0;
+        editorDfaAddClosure(dfa, 0, edge);
+
+        int state = editorDfaAddState(dfa);
+        dfa->start[edge] = state;
+    }
+
+    return dfa->start[edge];
+}
+
+/*
+ * Build the transition of state `from` for the bytes of class `class`, returns the next state
+ */
+int editorDfaStep(struct editorDfa *dfa, int from, int class) {
+    const struct editorRegexInstruction *code = dfa->program->code;
+    int byte = dfa->regex->class_bytes[class];
+    int flushes = dfa->flushes;
+
+    editorDfaNewMark(dfa);
+    dfa->build_len = 0;
+
+    struct editorDfaState state = dfa->states[from];
+    for (int i = 0; i < state.len; i++) {
+        int pc = dfa->pool[state.offset + i];
+
+        if (code[pc].op == OP_BYTE && editorByteSetHas(&dfa->regex->sets[code[pc].set], byte)) {
+            editorDfaAddClosure(dfa, code[pc].x, false);
+        }
+    }
+
+    // Scans also start at the byte, but only join the state once they consumed it.
+    // States after the first byte so only accept non-empty matches.
+    for (int i = 0; i < dfa->restart_len; i++) {
+        int pc = dfa->restart[i];
+
+        if (code[pc].op == OP_BYTE && editorByteSetHas(&dfa->regex->sets[code[pc].set], byte)) {
+            editorDfaAddClosure(dfa, code[pc].x, false);
+        }
+    }
+
+    int next = editorDfaAddState(dfa);
+
+    // The transition is only kept if `from` was not dropped to make room for the next state
+    if (dfa->flushes == flushes) {
+        dfa->next[from * dfa->regex->class_count + class] = next;
+    }
+
+    return next;
+}
+
+/*
+ * Return the state after state `from` consumed `byte`, built on first use
+ */
+int editorDfaNext(struct editorDfa *dfa, int from, unsigned char byte) {
+    int class = dfa->regex->classes[byte];
+    int next = dfa->next[from * dfa->regex->class_count + class];
+
+    return next != -1 ? next : editorDfaStep(dfa, from, class);
+}
+
+/*** matching ***/
+
+/*
+ * Create a matcher for `regex`, its states are only built when a scan reaches them
+ */
+struct editorRegexMatcher *editorRegexMatcherNew(const struct editorRegex *regex) {
+    struct editorRegexMatcher *matcher = calloc(1, sizeof(struct editorRegexMatcher));
+
+    editorDfaInit(&matcher->forward, regex, &regex->forward, false);
+    editorDfaInit(&matcher->backward, regex, &regex->backward, true);
+
+    return matcher;
+}
+
+/*
+ * Free matcher `matcher`
+ */
+void editorRegexMatcherFree(struct editorRegexMatcher *matcher) {
+    editorDfaFree(&matcher->forward);
+    editorDfaFree(&matcher->backward);
+    free(matcher->starts);
+    free(matcher);
+}
+
+/*
+ * Find every position of the line a non-empty match starts at, by scanning the line backwards with the reversed
+ * pattern. The scan is in an accepting state after reading the line back to a position if a match of at least
+ * one byte starts there, so positions where only the empty string matches are skipped without a forward scan.
+ */
+void editorRegexFindStarts(struct editorRegexMatcher *matcher, const char *text, int size) {
+    if (size + 1 > matcher->starts_capacity) {
+        matcher->starts_capacity = size + 1 > 2 * matcher->starts_capacity ? size + 1 : 2 * matcher->starts_capacity;
+        matcher->starts = realloc(matcher->starts, matcher->starts_capacity);
+    }
+
+    matcher->line = text;
+    matcher->line_size = size;
+
+    struct editorDfa *dfa = &matcher->backward;
+    int state = editorDfaStart(dfa, true);
+
+    // The tables are kept in locals (the stores to `starts` could change them otherwise), they only change when
+    // a transition is built
+    const uint8_t *classes = dfa->regex->classes;
+    int class_count = dfa->regex->class_count;
+    const struct editorDfaState *states = dfa->states;
+    const int *next = dfa->next;
+
+    for (int pos = size; ; pos--) {
+        // Anchors at the start of the line only hold at its first position. Nothing was read at the end of the line,
+        // the start state only accepts the empty match there.
+        if (pos == size) {
+            matcher->starts[pos] = false;
+        } else {
+            matcher->starts[pos] = pos == 0 ? states[state].accept_end : states[state].accept;
+        }
+
+        if (pos == 0) {
+            break;
+        }
+
+        int class = classes[(unsigned char)text[pos - 1]];
+        int following = next[state * class_count + class];
+
+        if (following == -1) {
+            following = editorDfaStep(dfa, state, class);
+            states = dfa->states;
+            next = dfa->next;
+        }
+
+        state = following;
+    }
+}
+
+/*
+ * Return the end of the longest match starting at `start`, -1 if there is none
+ */
+int editorRegexLongestMatch(struct editorRegexMatcher *matcher, const char *text, int size, int start) {
+    struct editorDfa *dfa = &matcher->forward;
+    int state = editorDfaStart(dfa, start == 0);
+    int longest = -1;
+
+    for (int pos = start; ; pos++) {
+        if (pos == size ? dfa->states[state].accept_end : dfa->states[state].accept) {
+            longest = pos;
+        }
+
+        // Stop at the end of the line, or when no match can continue
+        if (pos == size || dfa->states[state].len == 0) {
+            break;
+        }
+
+        state = editorDfaNext(dfa, state, text[pos]);
+    }
+
+    return longest;
+}
+
+/*
+ * Find the first non-empty match in line `text` (of `size` characters) that starts at or after `from`,
+ * the longest one if several matches start there. Returns `false` if there is none.
+ * The line is scanned backwards once to find where matches start (when `from` is 0 or the line changed),
+ * then each match is scanned forwards from its start. Every scan is a DFA walk over the text, without backtracking.
+ */
+bool editorRegexFind(struct editorRegexMatcher *matcher, const char *text, int size, int from, int *start, int *end) {
+    if (from == 0 || text != matcher->line || size != matcher->line_size) {
+        editorRegexFindStarts(matcher, text, size);
+    }
+
+    for (int pos = from; pos <= size; pos++) {
+        const char *next = memchr(&matcher->starts[pos], 1, size + 1 - pos);
+        if (next == NULL) {
+            return false;
+        }
+
+        pos = next - matcher->starts;
+
+        int match_end = editorRegexLongestMatch(matcher, text, size, pos);
+        if (match_end > pos) {
+            *start = pos;
+            *end = match_end;
+            return true;
+        }
+    }
+
+    return false;
+}
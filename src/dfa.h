@@ -0,0 +1,64 @@
+#ifndef DFA_H
+#define DFA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Maximum number of instructions of a compiled pattern, larger patterns (e.g. nested counted repetitions) are rejected
+ */
+#define REGEX_MAX_PROGRAM 16384
+
+/*
+ * Maximum count of a counted repetition `{m,n}`
+ */
+#define REGEX_MAX_REPEAT 1000
+
+/*
+ * Number of DFA states a matcher keeps. When a scan needs more, all states are dropped and built again
+ * from the text being scanned, so the memory of a matcher is bounded whatever the pattern.
+ */
+#define REGEX_MAX_STATES 4096
+
+/*
+ * Compiled regular expression, can be shared (read only) by matchers on several threads
+ */
+struct editorRegex;
+
+/*
+ * Lazily built DFA of a regular expression, only used by one thread at a time
+ */
+struct editorRegexMatcher;
+
+/*
+ * Compile the `len` characters of extended regular expression `pattern`.
+ * Supports literals, `.`, bracket expressions (with ranges and [:class:] names), \d \w \s (and their negations),
+ * grouping, alternation, `*`, `+`, `?` and `{m,n}` repetitions, and `^` and `$` anchoring at the line edges.
+ * Returns NULL and sets `error` to a description of the problem if the pattern is invalid.
+ */
+struct editorRegex *editorRegexCompile(const char *pattern, size_t len, const char **error);
+
+/*
+ * Free compiled regular expression `regex`, after all of its matchers were freed
+ */
+void editorRegexFree(struct editorRegex *regex);
+
+/*
+ * Create a matcher for `regex`, its states are only built when a scan reaches them
+ */
+struct editorRegexMatcher *editorRegexMatcherNew(const struct editorRegex *regex);
+
+/*
+ * Free matcher `matcher`
+ */
+void editorRegexMatcherFree(struct editorRegexMatcher *matcher);
+
+/*
+ * Find the first non-empty match in line `text` (of `size` characters) that starts at or after `from`,
+ * the longest one if several matches start there. Returns `false` if there is none.
+ * The line is scanned backwards once to find where matches start (when `from` is 0 or the line changed),
+ * then each match is scanned forwards from its start. Every scan is a DFA walk over the text, without backtracking.
+ */
+bool editorRegexFind(struct editorRegexMatcher *matcher, const char *text, int size, int from, int *start, int *end);
+
+#endif
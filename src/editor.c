@@ -1,6 +1,9 @@
 #include "input.h"
+#include "arena.h"
 #include "editor.h"
 #include "highlight.h"
+#include "io.h"
+#include "parse.h"
 #include "terminal.h"
 #include <ctype.h>
 #include <stdarg.h>
@@ -14,16 +17,21 @@
 
 struct editorConfig E;
 
+/*
+ * Convert the (`row`, `column`) position to a byte offset in the text buffer
+ */
 uint32_t rowColPointToBytePoint(int row, int column) {
-    uint32_t byte = column;
-
-    for (int r = 0; r < row; r++) {
-        erow *row = &E.row[r];
-        // Size of the row + a newline
-        byte += row->size + 1;
-    }
+    // The row tree keeps the size of every row + a newline summed, no need to walk the rows
+    return rowTreeByteOffset(&E.rows, row) + column;
+}
 
-    return byte;
+/*
+ * Convert byte offset `byte` in the text buffer to a (`row`, `column`) position
+ */
+void bytePointToRowColPoint(uint32_t byte, int *row, int *column) {
+    long row_start;
+    *row = rowTreeRowAtByte(&E.rows, byte, &row_start);
+    *column = byte - row_start;
 }
 
 /*
@@ -37,21 +45,19 @@ bool isSeparator(int c) {
  * Returns the index of the first separator in towards sh: line 1: direction: command not found
  */
 int getSeparatorIndex(int direction) {
-    erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+    erow row = editorRowAt(E.cy);
 
-    if (row == NULL) {
+    if (!ROW_EXISTS(row)) {
         return 0;
     }
 
     switch (direction) {
         case LEFT:
             {
-                erow *row = &E.row[E.cy];
-
                 // find first separator character between column 0 and the current column
                 int last_separator_index = -1;
                 for (int i = E.cx - 1; i >= 0; i--) {
-                    char c = row->chars[i];
+                    char c = ROW_CHARS(row)[i];
 
                     if (isSeparator(c)) {
                         last_separator_index = i;
@@ -67,7 +73,7 @@ int getSeparatorIndex(int direction) {
                     // find first separator character between column 0 and the adjacent separator
                     int last_separator_index = -1;
                     for (int i = start - 1; i >= 0; i--) {
-                        char c = row->chars[i];
+                        char c = ROW_CHARS(row)[i];
 
                         if (isSeparator(c)) {
                             last_separator_index = i;
@@ -82,10 +88,10 @@ int getSeparatorIndex(int direction) {
             break;
         case RIGHT:
             {
-                // find first separator character between column row->size and the current column
-                int first_separator_index = row->size + 1;
-                for (int i = E.cx + 1; i < row->size; i++) {
-                    char c = row->chars[i];
+                // find first separator character between column ROW_SIZE(row) and the current column
+                int first_separator_index = ROW_SIZE(row) + 1;
+                for (int i = E.cx + 1; i < ROW_SIZE(row); i++) {
+                    char c = ROW_CHARS(row)[i];
 
                     if (isSeparator(c)) {
                         first_separator_index = i + 1;
@@ -93,15 +99,15 @@ int getSeparatorIndex(int direction) {
                     }
                 }
 
-                if (first_separator_index == row->size + 1) {
-                    return row->size;
+                if (first_separator_index == ROW_SIZE(row) + 1) {
+                    return ROW_SIZE(row);
                 } else if (E.cx + 1 == first_separator_index) {
                     // If we are next to a separator, delete until the next separator instead
                     int start = first_separator_index;
-                    // find first separator character between column row->size and the adjacent separator
-                    int first_separator_index = row->size + 1;
-                    for (int i = start + 1; i < row->size; i++) {
-                        char c = row->chars[i];
+                    // find first separator character between column ROW_SIZE(row) and the adjacent separator
+                    int first_separator_index = ROW_SIZE(row) + 1;
+                    for (int i = start + 1; i < ROW_SIZE(row); i++) {
+                        char c = ROW_CHARS(row)[i];
 
                         if (isSeparator(c)) {
                             first_separator_index = i + 1;
@@ -119,6 +125,13 @@ int getSeparatorIndex(int direction) {
     }
 }
 
+/*
+ * Return the row at line `at`, ROW_NONE if there is no such row (test with ROW_EXISTS)
+ */
+erow editorRowAt(int at) {
+    return rowTreeGet(&E.rows, at);
+}
+
 /*
  * Append `len` characters of chars `s` to editor
  */
@@ -128,39 +141,142 @@ void editorInsertRow(int at, char *s, size_t len) {
         return;
     }
 
-    // Increase memory for rows by 1 spot
-    E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1));
+    // Make space for the row in the row tree
+    erow row = rowTreeInsert(&E.rows, at, len);
+
+    ROW_CHARS(row) = arenaAlloc(len + 1);
+    memcpy(ROW_CHARS(row), s, len);
+    ROW_CHARS(row)[len] = '\0';
 
-    // Move all following rows to the next spot in memory
-    memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
+    ROW_RENDER_SIZE(row) = 0;
+    ROW_RENDER(row) = NULL;
+    ROW_HIGHLIGHT(row) = NULL;
+    ROW_OPEN_COMMENT(row) = false;
+    ROW_MAPPED(row) = false;
+    ROW_SHARED(row) = false;
 
-    for (int i = at + 1; i <= E.numrows; i++) {
-        E.row[i].index++;
+    E.numrows++;
+    E.dirty = true;
+}
+
+/*
+ * Insert a row at line `at` that points to `len` characters at `s` in the memory mapped file,
+ * the characters are only copied once the row is modified
+ */
+void editorInsertMappedRow(int at, char *s, size_t len) {
+    // Only add within editor range
+    if (at < 0 || at > E.numrows) {
+        return;
     }
 
-    E.row[at].index = at;
+    erow row = rowTreeInsert(&E.rows, at, len);
 
-    E.row[at].size = len;
-    E.row[at].chars = malloc(len + 1);
-    memcpy(E.row[at].chars, s, len);
-    E.row[at].chars[len] = '\0';
+    ROW_CHARS(row) = s;
 
-    E.row[at].renderSize = 0;
-    E.row[at].render = NULL;
-    E.row[at].highlight = NULL;
-    E.row[at].open_comment = false;
+    ROW_RENDER_SIZE(row) = 0;
+    ROW_RENDER(row) = NULL;
+    ROW_HIGHLIGHT(row) = NULL;
+    ROW_OPEN_COMMENT(row) = false;
+    ROW_MAPPED(row) = true;
+    ROW_SHARED(row) = false;
 
     E.numrows++;
-    E.dirty = true;
+}
+
+/*
+ * Characters of rows that were changed or deleted while a background thread may read them
+ */
+struct editorDeferred {
+    char **chars;
+    // Epoch of the row tree when the characters were replaced
+    int *epochs;
+    int count;
+    int capacity;
+};
+
+struct editorDeferred D = { NULL, NULL, 0, 0 };
+
+/*
+ * Free `chars` once no background thread (save or parse) reads them through a snapshot of the rows
+ */
+void editorDeferFree(char *chars) {
+    if (E.rows.snapshotCount == 0) {
+        arenaFree(chars);
+        return;
+    }
+
+    if (D.count == D.capacity) {
+        D.capacity = D.capacity ? D.capacity * 2 : 64;
+        D.chars = realloc(D.chars, sizeof(char *) * D.capacity);
+        D.epochs = realloc(D.epochs, sizeof(int) * D.capacity);
+    }
+
+    D.chars[D.count] = chars;
+    D.epochs[D.count] = E.rows.epoch;
+    D.count++;
+}
+
+/*
+ * Free the characters passed to editorDeferFree that are not read by a snapshot of the rows anymore
+ */
+void editorFreeDeferred() {
+    if (D.count == 0) {
+        return;
+    }
+
+    // Characters replaced before the oldest remaining snapshot was taken are not in any snapshot
+    int oldest = rowTreeOldestSnapshot(&E.rows);
+    int freed = 0;
+    while (freed < D.count && D.epochs[freed] <= oldest) {
+        arenaFree(D.chars[freed]);
+        freed++;
+    }
+
+    memmove(D.chars, &D.chars[freed], sizeof(char *) * (D.count - freed));
+    memmove(D.epochs, &D.epochs[freed], sizeof(int) * (D.count - freed));
+    D.count -= freed;
+}
+
+/*
+ * Return the row at line `at` after copying its characters out of the memory mapped file,
+ * or away from the snapshots of the background save and parse, so they can be modified.
+ * Other rows are invalidated.
+ */
+erow editorRowMakeWritable(int at) {
+    // Copies the leaf of the row if a snapshot reads it
+    erow row = rowTreeMakeWritable(&E.rows, at);
+
+    if (!ROW_MAPPED(row) && !rowTreeRowShared(&E.rows, row)) {
+        return row;
+    }
+
+    char *chars = arenaAlloc(ROW_SIZE(row) + 1);
+    memcpy(chars, ROW_CHARS(row), ROW_SIZE(row));
+    chars[ROW_SIZE(row)] = '\0';
+
+    // The background save or parse may still read the old characters
+    if (!ROW_MAPPED(row)) {
+        editorDeferFree(ROW_CHARS(row));
+    }
+
+    ROW_CHARS(row) = chars;
+    ROW_MAPPED(row) = false;
+    ROW_SHARED(row) = false;
+
+    return row;
 }
 
 /*
  * Free memory of `row`
  */
-void editorFreeRow(erow *row) {
-    free(row->render);
-    free(row->chars);
-    free(row->highlight);
+void editorFreeRow(erow row) {
+    arenaFree(ROW_RENDER(row));
+    if (rowTreeRowShared(&E.rows, row) && !ROW_MAPPED(row)) {
+        editorDeferFree(ROW_CHARS(row));
+    } else if (!ROW_MAPPED(row)) {
+        arenaFree(ROW_CHARS(row));
+    }
+    arenaFree(ROW_HIGHLIGHT(row));
 }
 
 /*
@@ -172,73 +288,80 @@ void editorDeleteRow(int at) {
         return;
     }
 
-    editorFreeRow(&E.row[at]);
-    // Move all rows after selected row one spot back in memory
-    memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
-
-    for (int i = at; i < E.numrows - 1; i++) {
-        E.row[i].index--;
-    }
+    editorFreeRow(editorRowAt(at));
+    // Remove the row from the row tree
+    rowTreeDelete(&E.rows, at);
 
     E.numrows--;
     E.dirty = true;
 }
 
 /*
- * Add character `c` to `row` at given position `at`
+ * Add character `c` to the row at line `row_at` at given position `at`
  */
-void editorRowInsertChar(erow *row, int at, char c) {
+void editorRowInsertChar(int row_at, int at, char c) {
+    erow row = editorRowMakeWritable(row_at);
+
     // allow inserting at end of line
-    if (at < 0 || at > row->size) {
-        at = row->size;
+    if (at < 0 || at > ROW_SIZE(row)) {
+        at = ROW_SIZE(row);
     }
 
-    // increase space for row.chars
-    row->chars = realloc(row->chars,row->size+2);
+    // increase space for row.chars, the arena grows capacities geometrically
+    ROW_CHARS(row) = arenaRealloc(ROW_CHARS(row), ROW_SIZE(row) + 2);
 
     // move characters after 'at' one spot to make space for the character
-    memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
+    memmove(&ROW_CHARS(row)[at + 1], &ROW_CHARS(row)[at], ROW_SIZE(row) - at + 1);
 
-    row->size++;
+    ROW_SIZE(row)++;
+    rowTreeAddBytes(&E.rows, row_at, 1);
 
-    row->chars[at] = c;
+    ROW_CHARS(row)[at] = c;
 
-    int old_end_byte = rowColPointToBytePoint(row->index, at);
+    int old_end_byte = rowColPointToBytePoint(row_at, at);
     int new_end_byte = old_end_byte + 1;
-    editorUpdateSyntaxHighlight(row->index, at, old_end_byte, row->index, at + 1, new_end_byte);
+    editorUpdateSyntaxHighlight(row_at, at, old_end_byte, row_at, at + 1, new_end_byte);
 
     E.dirty = true;
 }
 
 /*
- * Append string `s` of length `len` to row `row`
+ * Append string `s` of length `len` to the row at line `row_at`
  */
-void editorRowAppendString(erow *row, char *s, size_t len) {
+void editorRowAppendString(int row_at, char *s, size_t len) {
+    erow row = editorRowMakeWritable(row_at);
+
     // Increase size of row by length of string to append
-    row->chars = realloc(row->chars, row->size + len + 1);
-    memcpy(&row->chars[row->size], s, len);
-    row->size += len;
-    row->chars[row->size] = '\0';
+    ROW_CHARS(row) = arenaRealloc(ROW_CHARS(row), ROW_SIZE(row) + len + 1);
+    memcpy(&ROW_CHARS(row)[ROW_SIZE(row)], s, len);
+    ROW_SIZE(row) += len;
+    ROW_CHARS(row)[ROW_SIZE(row)] = '\0';
+    rowTreeAddBytes(&E.rows, row_at, len);
 
     E.dirty = true;
 }
 
 /*
- * Delete char at index `at` in row `row`
+ * Delete char at index `at` in the row at line `row_at`
  */
-void editorRowDeleteChar(erow *row, int at) {
+void editorRowDeleteChar(int row_at, int at) {
+    erow row = editorRowAt(row_at);
+
     // Only delete character actually in row
-    if (at < 0 || at >= row->size) {
+    if (at < 0 || at >= ROW_SIZE(row)) {
         return;
     }
 
+    row = editorRowMakeWritable(row_at);
+
     // Move chars after cursor one spot back
-    memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
-    row->size--;
+    memmove(&ROW_CHARS(row)[at], &ROW_CHARS(row)[at + 1], ROW_SIZE(row) - at);
+    ROW_SIZE(row)--;
+    rowTreeAddBytes(&E.rows, row_at, -1);
 
-    int old_end_byte = rowColPointToBytePoint(row->index, at + 1);
+    int old_end_byte = rowColPointToBytePoint(row_at, at + 1);
     int new_end_byte = old_end_byte - 1;
-    editorUpdateSyntaxHighlight(row->index, at + 1, old_end_byte, row->index, at, new_end_byte);
+    editorUpdateSyntaxHighlight(row_at, at + 1, old_end_byte, row_at, at, new_end_byte);
 
     E.dirty = true;
 }
@@ -251,9 +374,10 @@ void editorClearRowToStart() {
         return;
     }
 
-    erow *row = &E.row[E.cy];
-    memmove(&row->chars[0], &row->chars[E.cx], row->size - E.cx);
-    row->size -= E.cx;
+    erow row = editorRowMakeWritable(E.cy);
+    memmove(&ROW_CHARS(row)[0], &ROW_CHARS(row)[E.cx], ROW_SIZE(row) - E.cx);
+    ROW_SIZE(row) -= E.cx;
+    rowTreeAddBytes(&E.rows, E.cy, -E.cx);
 
     int old_end_byte = rowColPointToBytePoint(E.cy, E.cx);
     int new_end_byte = rowColPointToBytePoint(E.cy, 0);
@@ -278,7 +402,7 @@ void editorInsertChar(char c) {
     }
 
     // Insert character in current row
-    editorRowInsertChar(&E.row[E.cy], E.cx, c);
+    editorRowInsertChar(E.cy, E.cx, c);
     E.cx++;
 
     // Reset saved position
@@ -292,11 +416,12 @@ void editorInsertNewline() {
     if (E.cx == 0) {
         editorInsertRow(E.cy, "", 0);
     } else {
-        erow *row = &E.row[E.cy];
-        editorInsertRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx);
-        row = &E.row[E.cy];
-        row->size = E.cx;
-        row->chars[row->size] = '\0';
+        erow row = editorRowAt(E.cy);
+        editorInsertRow(E.cy + 1, &ROW_CHARS(row)[E.cx], ROW_SIZE(row) - E.cx);
+        row = editorRowMakeWritable(E.cy);
+        rowTreeAddBytes(&E.rows, E.cy, E.cx - ROW_SIZE(row));
+        ROW_SIZE(row) = E.cx;
+        ROW_CHARS(row)[ROW_SIZE(row)] = '\0';
     }
 
     int old_end_byte = rowColPointToBytePoint(E.cy, E.cx);
@@ -310,6 +435,75 @@ void editorInsertNewline() {
     E.savedCx = E.cx;
 }
 
+/*
+ * Insert the `len` characters at `s` at the current cursor position as a single edit, e.g. pasted text.
+ * Line breaks (\n, \r or \r\n) split the text into rows, the cursor is moved to the end of the text.
+ */
+void editorInsertText(const char *s, size_t len) {
+    // If the cursor is at the last (tilde) row, add an extra line first
+    if (E.cy == E.numrows) {
+        editorInsertRow(E.numrows, "", 0);
+    }
+
+    int start_byte = rowColPointToBytePoint(E.cy, E.cx);
+
+    // The characters after the cursor are moved to the end of the last inserted line
+    erow row = editorRowAt(E.cy);
+    size_t tail_len = ROW_SIZE(row) - E.cx;
+    char *tail = malloc(tail_len + 1);
+    memcpy(tail, &ROW_CHARS(row)[E.cx], tail_len);
+
+    row = editorRowMakeWritable(E.cy);
+    rowTreeAddBytes(&E.rows, E.cy, -(int)tail_len);
+    ROW_SIZE(row) = E.cx;
+    ROW_CHARS(row)[ROW_SIZE(row)] = '\0';
+
+    // The first line is appended to the current row, the others become new rows
+    int at = E.cy;
+    int inserted = 0;
+    size_t pos = 0;
+
+    while (true) {
+        size_t end = pos;
+        while (end < len && s[end] != '\n' && s[end] != '\r') {
+            end++;
+        }
+
+        if (at == E.cy) {
+            editorRowAppendString(at, (char *)&s[pos], end - pos);
+        } else {
+            editorInsertRow(at, (char *)&s[pos], end - pos);
+        }
+
+        inserted += end - pos;
+
+        if (end == len) {
+            break;
+        }
+
+        // A line break counts as a single newline in the buffer
+        if (s[end] == '\r' && end + 1 < len && s[end + 1] == '\n') {
+            end++;
+        }
+
+        pos = end + 1;
+        inserted++;
+        at++;
+    }
+
+    int end_column = ROW_SIZE(editorRowAt(at));
+    editorRowAppendString(at, tail, tail_len);
+    free(tail);
+
+    editorUpdateSyntaxHighlight(E.cy, E.cx, start_byte, at, end_column, start_byte + inserted);
+
+    E.cy = at;
+    E.cx = end_column;
+
+    // Reset saved position
+    E.savedCx = E.cx;
+}
+
 /*
  * Perform backspace action
  */
@@ -319,20 +513,20 @@ void editorDeleteChar() {
         return;
     }
 
-    erow *row = &E.row[E.cy];
+    erow row = editorRowAt(E.cy);
     if (E.cx > 0) {
-        editorRowDeleteChar(row, E.cx - 1);
+        editorRowDeleteChar(E.cy, E.cx - 1);
         E.cx--;
     } else {
         // If backspace is pressed at the start of the line, append the current line to the previous line
 
         // Put cursor at end of previous line
-        E.cx = E.row[E.cy - 1].size;
+        E.cx = ROW_SIZE(editorRowAt(E.cy - 1));
 
         int old_end_byte = rowColPointToBytePoint(E.cy, 0);
 
         // Join lines
-        editorRowAppendString(&E.row[E.cy - 1], row->chars, row->size);
+        editorRowAppendString(E.cy - 1, ROW_CHARS(row), ROW_SIZE(row));
 
         // Delete old line
         editorDeleteRow(E.cy);
@@ -349,12 +543,15 @@ void editorDeleteChar() {
 
 
 void editorDeleteWord() {
-    erow *row = &E.row[E.cy];
+    erow row = editorRowAt(E.cy);
 
     int newPos = getSeparatorIndex(LEFT);
 
-    memmove(&row->chars[newPos], &row->chars[E.cx], row->size - E.cx);
-    row->size -= E.cx - newPos;
+    row = editorRowMakeWritable(E.cy);
+
+    memmove(&ROW_CHARS(row)[newPos], &ROW_CHARS(row)[E.cx], ROW_SIZE(row) - E.cx);
+    ROW_SIZE(row) -= E.cx - newPos;
+    rowTreeAddBytes(&E.rows, E.cy, newPos - E.cx);
 
     int old_end_byte = rowColPointToBytePoint(E.cy, E.cx);
     int new_end_byte = rowColPointToBytePoint(E.cy, newPos);
@@ -370,25 +567,45 @@ void editorDeleteWord() {
 /*** append buffer ***/
 
 /*
- * Append `len` characters `s` to append buffer `ab`
+ * Append `len` characters `s` to append buffer `ab`.
+ * The buffer grows geometrically, so appending is amortized O(1).
  */
 void abAppend(struct abuf *ab, const char *s, int len) {
-    char *new = realloc(ab->b, ab->len + len);
+    if (ab->len + len > ab->capacity) {
+        int capacity = ab->capacity ? ab->capacity : 64;
+        while (capacity < ab->len + len) {
+            capacity *= 2;
+        }
 
-    if (new == NULL) {
-        return;
+        char *new = realloc(ab->b, capacity);
+
+        if (new == NULL) {
+            return;
+        }
+
+        ab->b = new;
+        ab->capacity = capacity;
     }
 
-    memcpy(&new [ab->len], s, len);
-    ab->b = new;
+    memcpy(&ab->b[ab->len], s, len);
     ab->len += len;
 }
 
+/*
+ * Empty append buffer `ab`, keeping its memory for reuse
+ */
+void abClear(struct abuf *ab) {
+    ab->len = 0;
+}
+
 /*
  * Free append buffer `ab`
  */
 void abFree(struct abuf *ab) {
     free(ab->b);
+    ab->b = NULL;
+    ab->len = 0;
+    ab->capacity = 0;
 }
 
 /*
@@ -419,9 +636,13 @@ void initEditor() {
 
     // Number of rows
     E.numrows = 0;
-    E.row = NULL;
+    E.rows = (rowTree)ROW_TREE_INIT;
+
+    E.map = NULL;
+    E.mapSize = 0;
 
     E.line_nr_len = 0;
+    E.relative_line_nrs = false;
 
     E.dirty = false;
     E.forceQuit = false;
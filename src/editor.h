@@ -1,25 +1,14 @@
 #ifndef EDITOR_H
 #define EDITOR_H
 
+#include "buffer.h"
 #include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <termios.h>
 
 #define TAB_SIZE 4
 
-/*
- * A row in the editor
- */
-typedef struct erow {
-    int index;
-    int size;
-    char *chars;
-    int renderSize;
-    char *render;
-    unsigned char *highlight;
-    bool open_comment;
-} erow;
-
 /*
  * Struct for storing information about the editor
  */
@@ -40,11 +29,17 @@ typedef struct editorConfig {
 
     // Number of rows
     int numrows;
-    // Pointer to rows
-    erow *row;
+    // Rows of the text buffer
+    rowTree rows;
+
+    // Read-only memory mapping of the opened file, unmodified rows point into it
+    char *map;
+    size_t mapSize;
 
     // Width of line number column
     int line_nr_len;
+    // Show line numbers relative to the cursor row
+    bool relative_line_nrs;
 
     // Set to true if text buffer has been modified since opening or saving
     bool dirty;
@@ -70,6 +65,16 @@ typedef struct editorConfig {
     struct termios orig_termios;
 } editorConfig;
 
+/*
+ * Convert the (`row`, `column`) position to a byte offset in the text buffer
+ */
+uint32_t rowColPointToBytePoint(int row, int column);
+
+/*
+ * Convert byte offset `byte` in the text buffer to a (`row`, `column`) position
+ */
+void bytePointToRowColPoint(uint32_t byte, int *row, int *column);
+
 /*
  * Returns `true` if character `c` is considered a separator of words
  */
@@ -80,15 +85,43 @@ bool isSeparator(int c);
  */
 int getSeparatorIndex(int direction);
 
+/*
+ * Return the row at line `at`, ROW_NONE if there is no such row (test with ROW_EXISTS)
+ */
+erow editorRowAt(int at);
+
 /*
  * Append `len` characters of chars `s` to editor
  */
 void editorInsertRow(int at, char *s, size_t len);
 
+/*
+ * Insert a row at line `at` that points to `len` characters at `s` in the memory mapped file,
+ * the characters are only copied once the row is modified
+ */
+void editorInsertMappedRow(int at, char *s, size_t len);
+
+/*
+ * Free `chars` once no background thread (save or parse) reads them through a snapshot of the rows
+ */
+void editorDeferFree(char *chars);
+
+/*
+ * Free the characters passed to editorDeferFree that are not read by a snapshot of the rows anymore
+ */
+void editorFreeDeferred();
+
+/*
+ * Return the row at line `at` after copying its characters out of the memory mapped file,
+ * or away from the snapshots of the background save and parse, so they can be modified.
+ * Other rows are invalidated.
+ */
+erow editorRowMakeWritable(int at);
+
 /*
  * Free memory of `row`
  */
-void editorFreeRow(erow *row);
+void editorFreeRow(erow row);
 
 /*
  * Delete row at line `at`
@@ -96,14 +129,14 @@ void editorFreeRow(erow *row);
 void editorDeleteRow(int at);
 
 /*
- * Append string `s` of length `len` to row `row`
+ * Append string `s` of length `len` to the row at line `row_at`
  */
-void editorRowAppendString(erow *row, char *s, size_t len);
+void editorRowAppendString(int row_at, char *s, size_t len);
 
 /*
- * Delete char at index `at` in row `row`
+ * Delete char at index `at` in the row at line `row_at`
  */
-void editorRowDeleteChar(erow *row, int at);
+void editorRowDeleteChar(int row_at, int at);
 
 /*
  * Delete characters in current row from cursor x to start
@@ -120,6 +153,12 @@ void editorInsertChar(char c);
  */
 void editorInsertNewline();
 
+/*
+ * Insert the `len` characters at `s` at the current cursor position as a single edit, e.g. pasted text.
+ * Line breaks (\n, \r or \r\n) split the text into rows, the cursor is moved to the end of the text.
+ */
+void editorInsertText(const char *s, size_t len);
+
 /*
  * Perform backspace action
  */
@@ -130,15 +169,22 @@ void editorDeleteWord();
 struct abuf {
     char *b;
     int len;
+    int capacity;
 };
 
-#define ABUF_INIT {NULL, 0}
+#define ABUF_INIT {NULL, 0, 0}
 
 /*
- * Append `len` characters `s` to append buffer `ab`
+ * Append `len` characters `s` to append buffer `ab`.
+ * The buffer grows geometrically, so appending is amortized O(1).
  */
 void abAppend(struct abuf *ab, const char *s, int len);
 
+/*
+ * Empty append buffer `ab`, keeping its memory for reuse
+ */
+void abClear(struct abuf *ab);
+
 /*
  * Free append buffer `ab`
  */
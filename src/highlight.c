@@ -1,10 +1,12 @@
+#include "arena.h"
 #include "highlight.h"
-#include "io.h"
+#include "keywords.h"
 #include "languages.h"
+#include "parse.h"
+#include "query.h"
 #include "render.h"
 #include "terminal.h"
 #include <ctype.h>
-#include <regex.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,75 +30,158 @@ bool inStringArray(const char *string, char **array) {
     return false;
 }
 
-void editorHighlightSubtree(TSNode root, uint32_t start_row, uint32_t end_row) {
-    if (ts_node_is_null(root)) {
-        return;
+/*
+ * Names of the `editorNamePattern`s, as used by the #name? query predicate
+ */
+char *namePatterns[] = { "constant", "dunder", "capitalized", "keyword1", "keyword2", NULL };
+
+/*
+ * Return the `editorNamePattern` called `name`, -1 if there is none
+ */
+int editorNamePatternFor(const char *name) {
+    for (int i = 0; namePatterns[i] != NULL; i++) {
+        if (!strcmp(name, namePatterns[i])) {
+            return i;
+        }
     }
 
-    const char *type = ts_node_type(root);
-    // printf("node type: \t'%s'\r\n", type);
+    return -1;
+}
 
-    // uint32_t start_byte = ts_node_start_byte(root);
-    // uint32_t end_byte = ts_node_end_byte(root);
-    // printf("start byte: %d, end_byte: %d\r\n",  start_byte, end_byte);
+/*
+ * Returns `true` if the `length` characters at `name` (e.g. an identifier in a row) match `pattern`.
+ * Only looks at the characters of the name, does not allocate and does not need NUL terminated text.
+ */
+bool editorMatchName(const char *name, uint32_t length, enum editorNamePattern pattern) {
+    switch (pattern) {
+        // Assume constant consists of capital letters, numbers or '_'
+        case NAME_CONSTANT:
+            if (length < 2) {
+                return false;
+            }
 
-    uint32_t child_count = ts_node_child_count(root);
+            for (uint32_t i = 0; i < length; i++) {
+                char c = name[i];
+                if ((c < '0' || c > '9') && (c < 'A' || c > 'Z') && c != '_') {
+                    return false;
+                }
+            }
 
-    // printf("%d child(ren)\r\n", child_count);
+            return true;
 
-    TSPoint start = ts_node_start_point(root);
-    TSPoint end = ts_node_end_point(root);
+        // Letters surrounded by double underscores, e.g. __init__
+        case NAME_DUNDER:
+            if (length < 5 || strncmp(name, "__", 2) || strncmp(&name[length - 2], "__", 2)) {
+                return false;
+            }
 
-    int highlight = HL_NORMAL;
+            for (uint32_t i = 2; i < length - 2; i++) {
+                if (!isalpha((unsigned char)name[i])) {
+                    return false;
+                }
+            }
+
+            return true;
+
+        case NAME_CAPITALIZED:
+            return length > 0 && name[0] >= 'A' && name[0] <= 'Z';
+
+        case NAME_KEYWORD1:
+            return editorKeywordHighlight(name, length) == HL_KEYWORD1;
+
+        case NAME_KEYWORD2:
+            return editorKeywordHighlight(name, length) == HL_KEYWORD2;
+    }
+
+    return false;
+}
+
+/*
+ * Set the highlight of the characters from `start` up to `end` to `highlight`,
+ * only changing the rows from `start_row` up to and including `end_row`
+ */
+void editorApplyHighlight(TSPoint start, TSPoint end, int highlight, uint32_t start_row, uint32_t end_row) {
+    uint32_t first = start.row > start_row ? start.row : start_row;
+    uint32_t last = end.row < end_row ? end.row : end_row;
+
+    rowIterator it;
+    rowTreeIterate(&E.rows, first, &it);
+
+    for (uint32_t r = first; r <= last; r++) {
+        erow row = rowIteratorNext(&it);
+        if (!ROW_EXISTS(row)) {
+            break;
+        }
+
+        // Only the first and last row of a node spanning multiple lines are partially highlighted
+        uint32_t from = r == start.row ? start.column : 0;
+        uint32_t to = r == end.row ? end.column : (uint32_t)ROW_SIZE(row);
+
+        if (to > (uint32_t)ROW_SIZE(row)) {
+            to = ROW_SIZE(row);
+        }
+
+        if (from < to) {
+            memset(&ROW_HIGHLIGHT(row)[from], highlight, to - from);
+        }
+    }
+}
+
+/*
+ * Determine how syntax tree nodes of the symbol named `type` are highlighted in the current language.
+ * Only used to build the symbol table, so names are compared once per symbol instead of once per node.
+ */
+struct editorSymbolClass editorClassifySymbol(const char *type) {
+    struct editorSymbolClass class = { HL_NORMAL, HANDLE_NONE, HANDLE_NONE };
 
     /*
      * Direct language agnostic highlighting
      */
     // Number
     if (inStringArray(type, (char*[]) { "number_literal", "integer", "float", "integer_literal", NULL })) {
-        highlight = HL_NUMBER;
+        class.highlight = HL_NUMBER;
     }
     // storage, type qualifier
     else if (inStringArray(type, (char*[]) { "storage_class_specifier", "type_qualifier", NULL })) {
-        highlight = HL_KEYWORD2;
+        class.highlight = HL_KEYWORD2;
     }
     // keywords type 1
     else if (inStringArray(type, E.syntax->keyword1)) {
-        highlight = HL_KEYWORD1;
+        class.highlight = HL_KEYWORD1;
     }
     // keywords type 2
     else if (inStringArray(type, E.syntax->keyword2)) {
-        highlight = HL_KEYWORD2;
+        class.highlight = HL_KEYWORD2;
     }
     // primitive types
     else if (inStringArray(type, (char*[]) { "primitive_type", "type_identifier", "sized_type_specifier", NULL })) {
-        highlight = HL_KEYWORD2;
+        class.highlight = HL_KEYWORD2;
     }
     // string
     else if (inStringArray(type, (char*[]) { "string_literal", "system_lib_string", "char_literal", "string", "raw_string_literal", NULL })) {
-        highlight = HL_STRING;
+        class.highlight = HL_STRING;
     }
     else if (!strcmp(type, "escape_sequence")) {
-        highlight = HL_SYNTAX1;
+        class.highlight = HL_SYNTAX1;
     }
     // comment
     else if (inStringArray(type, (char*[]) { "comment", "line_comment", NULL })) {
-        highlight = HL_COMMENT;
+        class.highlight = HL_COMMENT;
     }
     // syntax separators
     else if (inStringArray(type, E.syntax->syntax1)) {
-        highlight = HL_SYNTAX1;
+        class.highlight = HL_SYNTAX1;
     }
     else if (inStringArray(type, E.syntax->syntax2)) {
-        highlight = HL_SYNTAX2;
+        class.highlight = HL_SYNTAX2;
     }
     // unary expression
     else if (inStringArray(type, (char*[]) { "unary_expression", "pointer_expression", "pointer_declarator", "abstract_pointer_declarator", NULL })) {
-        highlight = HL_KEYWORD1;
-        end.column = start.column + 1;
+        class.highlight = HL_KEYWORD1;
+        class.handler = HANDLE_FIRST_CHARACTER;
     }
     else if (!strcmp(type, "null")) {
-        highlight = HL_SYNTAX2;
+        class.highlight = HL_SYNTAX2;
     }
 
     /*
@@ -104,13 +189,7 @@ void editorHighlightSubtree(TSNode root, uint32_t start_row, uint32_t end_row) {
      */
     // return
     else if (!strcmp(type, "return_statement")) {
-        TSNode return_child = ts_node_child(root, 0);
-
-        if (!ts_node_is_null(return_child)) {
-            highlight = HL_KEYWORD2;
-            start = ts_node_start_point(return_child);
-            end = ts_node_end_point(return_child);
-        }
+        class.handler = HANDLE_RETURN;
     }
 
     /*
@@ -119,60 +198,313 @@ void editorHighlightSubtree(TSNode root, uint32_t start_row, uint32_t end_row) {
 
     // Special identifiers
     else if (!strcmp(type, "identifier")) {
-        int len = end.column - start.column;
-
-        // Constants
-        if (len > 1) {
-            erow *row = &E.row[start.row];
-
-            bool is_constant = true;
-            for (uint32_t c = start.column; c < end.column; c++) {
-                // Assume constant consists of capital letters, numbers or '_'
-                if ((row->chars[c] < '0' || row->chars[c] > '9') &&
-                    (row->chars[c] < 'A' || row->chars[c] > 'Z') &&
-                     row->chars[c] != '_') {
-                    is_constant = false;
-                    break;
-                }
-            }
+        class.handler = HANDLE_IDENTIFIER;
+    }
 
-            if (is_constant) {
-                highlight = HL_CONSTANT;
-            }
+    // function name
+    else if (!strcmp(type, "function_declarator")) {
+        class.handler = HANDLE_FUNCTION_DECLARATOR;
+    }
+    else if (!strcmp(type, "call_expression")) {
+        class.handler = HANDLE_CALL_EXPRESSION;
+    }
+    else if (!strcmp(type, "call")) {
+        class.handler = HANDLE_CALL;
+    }
+    else if (!strcmp(type, "function_item")) {
+        class.handler = HANDLE_FUNCTION_ITEM;
+    }
+
+    /*
+     * Language specific highlighting, direct highlights replace the language agnostic highlighting
+     */
+    struct editorSymbolClass direct = { HL_NORMAL, HANDLE_NONE, HANDLE_NONE };
+
+    // Rust
+    if (!strcmp(E.syntax->filetype, "Rust")) {
+        /*
+         * Direct
+         */
+
+        // meta item (Rust)
+        if (!strcmp(type, "meta_item")) {
+            direct.highlight = HL_KEYWORD2;
+            class = direct;
         }
 
-        // Identifiers part of the specified keywords
+        // mutable specifier keyword (Rust)
+        else if (!strcmp(type, "mutable_specifier")) {
+            direct.highlight = HL_KEYWORD1;
+            class = direct;
+        }
 
-        // Copy identifier text
-        char *word;
-        word = malloc(len + 1);
-        erow *row = &E.row[start.row];
-        memcpy(word, &row->chars[start.column], len);
-        word[len] = '\0';
+        // fields (Rust)
+        else if (!strcmp(type, "field_identifier")) {
+            direct.highlight = HL_FUNCTION;
+            class = direct;
+        }
 
-        // printf("WORD:%s\r\n", word);
+        // use list (Rust)
+        else if (!strcmp(type, "use_list")) {
+            direct.highlight = HL_KEYWORD2;
+            class = direct;
+        }
 
-        if (inStringArray(word, E.syntax->keyword2)) {
-            highlight = HL_KEYWORD2;
-        } else if (inStringArray(word, E.syntax->keyword1)) {
-            highlight = HL_KEYWORD1;
+        // use wildcard * (Rust)
+        else if (!strcmp(type, "use_wildcard")) {
+            direct.highlight = HL_NORMAL;
+            class = direct;
+        }
+
+        // enum item
+        else if (!strcmp(type, "enum_variant")) {
+            direct.highlight = HL_CONSTANT;
+            class = direct;
+        }
+
+        /*
+         * Child
+         */
+
+        // parameter (Rust)
+        else if (!strcmp(type, "parameter")) {
+            class.language_handler = HANDLE_RUST_PARAMETER;
         }
 
-        free(word);
+        // macro name (Rust)
+        else if (!strcmp(type, "macro_invocation")) {
+            class.language_handler = HANDLE_RUST_MACRO_INVOCATION;
+        }
+
+        // field expression (Rust)
+        else if (!strcmp(type, "field_expression")) {
+            class.language_handler = HANDLE_RUST_FIELD_EXPRESSION;
+        }
+
+        /*
+         * Complex
+         */
+
+        // scoped identifier (Rust)
+        else if (inStringArray(type, (char*[]) { "scoped_identifier", "scoped_type_identifier", NULL })) {
+            class.language_handler = HANDLE_RUST_SCOPED_IDENTIFIER;
+        }
+
+        // match pattern types
+        else if (!strcmp(type, "match_pattern")) {
+            class.language_handler = HANDLE_RUST_MATCH_PATTERN;
+        }
     }
 
-    // function name
-    else if (inStringArray(type, (char*[]) { "function_declarator", "call_expression", "call", "function_item", NULL })) {
-        TSNode function_name;
-        bool set = false;
+    // Python
+    else if (!strcmp(E.syntax->filetype, "Python")) {
+        // except (Python)
+        if (!strcmp(type, "except_clause")) {
+            class.language_handler = HANDLE_PYTHON_EXCEPT_CLAUSE;
+        }
+
+        else if (!strcmp(type, "keyword_argument")) {
+            class.language_handler = HANDLE_PYTHON_KEYWORD_ARGUMENT;
+        }
+
+        /*
+         * Complex
+         */
+
+        // Fields (Python) - atttributes without parameter list
+        else if (!strcmp(type, "attribute")) {
+            class.language_handler = HANDLE_PYTHON_ATTRIBUTE;
+        }
+
+        // Python __XXX__ constants
+        else if (!strcmp(type, "identifier")) {
+            class.language_handler = HANDLE_PYTHON_IDENTIFIER;
+        }
+    }
+
+    // C
+    else if (!strcmp(E.syntax->filetype, "c")) {
+        /*
+         * Direct
+         */
+
+        // fields
+        if (!strcmp(type, "field_identifier")) {
+            direct.highlight = HL_FIELD;
+            class = direct;
+        }
+    }
+
+    else if (!strcmp(E.syntax->filetype, "Haskell")) {
+        /*
+         * Direct
+         */
+
+        // pragma
+        if (!strcmp(type, "pragma")) {
+            direct.highlight = HL_KEYWORD1;
+            class = direct;
+        }
+
+        // import path
+        else if (!strcmp(type, "module")) {
+            direct.highlight = HL_FIELD;
+            class = direct;
+        }
+
+        // import item
+        else if (!strcmp(type, "import_item")) {
+            direct.highlight = HL_NORMAL;
+            class = direct;
+        }
+
+        // type
+        else if (!strcmp(type, "constructor")) {
+            direct.highlight = HL_FIELD;
+            class = direct;
+        }
+
+        // char
+        else if (!strcmp(type, "char")) {
+            direct.highlight = HL_STRING;
+            class = direct;
+        }
+
+        /*
+         * Child
+         */
+
+        // function (Haskell)
+        else if (!strcmp(type, "function")) {
+            class.language_handler = HANDLE_HASKELL_FUNCTION;
+        }
+
+        // type signature
+        else if (!strcmp(type, "signature")) {
+            class.language_handler = HANDLE_HASKELL_SIGNATURE;
+        }
+
+        /*
+         * Complex
+         */
+
+        // import
+        else if (!strcmp(type, "import")) {
+            class.language_handler = HANDLE_HASKELL_IMPORT;
+        }
+
+        // type
+        else if (!strcmp(type, "type")) {
+            class.language_handler = HANDLE_HASKELL_TYPE;
+        }
+    }
+
+    return class;
+}
+
+/*
+ * Build the table mapping every symbol of the current language to its highlighting
+ */
+void editorInitSymbolTable() {
+    uint32_t count = ts_language_symbol_count(E.syntax->language);
+
+    free(E.syntax->symbols);
+    E.syntax->symbols = malloc(sizeof(struct editorSymbolClass) * count);
+    E.syntax->symbol_count = count;
+
+    for (uint32_t symbol = 0; symbol < count; symbol++) {
+        const char *name = ts_language_symbol_name(E.syntax->language, symbol);
+
+        if (name == NULL) {
+            E.syntax->symbols[symbol] = (struct editorSymbolClass){ HL_NORMAL, HANDLE_NONE, HANDLE_NONE };
+        } else {
+            E.syntax->symbols[symbol] = editorClassifySymbol(name);
+        }
+    }
+}
+
+/*
+ * Highlight the part of syntax tree node `node` (not its children) on the rows
+ * from `start_row` up to and including `end_row`.
+ * The node's symbol is looked up in the symbol table, only nodes with a handler look at their children.
+ */
+void editorHighlightNode(TSNode node, uint32_t start_row, uint32_t end_row) {
+    TSSymbol symbol = ts_node_symbol(node);
+
+    // Error nodes have symbols outside the language's symbols and are not highlighted
+    if (symbol >= E.syntax->symbol_count) {
+        return;
+    }
+
+    struct editorSymbolClass class = E.syntax->symbols[symbol];
 
-        if (!strcmp(type, "function_declarator")) {
+    // Most nodes are not highlighted at all
+    if (class.highlight == HL_NORMAL && class.handler == HANDLE_NONE && class.language_handler == HANDLE_NONE) {
+        return;
+    }
+
+    TSPoint start = ts_node_start_point(node);
+    TSPoint end = ts_node_end_point(node);
+
+    int highlight = class.highlight;
+
+    /*
+     * Language agnostic handlers
+     */
+    switch (class.handler) {
+        // unary expression
+        case HANDLE_FIRST_CHARACTER:
+            end.column = start.column + 1;
+            break;
+
+        // return
+        case HANDLE_RETURN: {
+            TSNode return_child = ts_node_child(node, 0);
+
+            if (!ts_node_is_null(return_child)) {
+                highlight = HL_KEYWORD2;
+                start = ts_node_start_point(return_child);
+                end = ts_node_end_point(return_child);
+            }
+            break;
+        }
+
+        // Special identifiers
+        case HANDLE_IDENTIFIER: {
+            int len = end.column - start.column;
+
+            erow row = editorRowAt(start.row);
+
+            // Constants
+            if (editorMatchName(&ROW_CHARS(row)[start.column], len, NAME_CONSTANT)) {
+                highlight = HL_CONSTANT;
+            }
+
+            // Identifiers part of the specified keywords
+            int keyword = editorKeywordHighlight(&ROW_CHARS(row)[start.column], len);
+            if (keyword != -1) {
+                highlight = keyword;
+            }
+            break;
+        }
+
+        // function name
+        case HANDLE_FUNCTION_DECLARATOR: {
             char *field_name = "declarator";
-            function_name = ts_node_child_by_field_name(root, field_name, strlen(field_name));
-            set = true;
-        } else if (!strcmp(type, "call_expression")) {
+            TSNode function_name = ts_node_child_by_field_name(node, field_name, strlen(field_name));
+
+            if (!ts_node_is_null(function_name)) {
+                highlight = HL_FUNCTION;
+                start = ts_node_start_point(function_name);
+                end = ts_node_end_point(function_name);
+            }
+            break;
+        }
+
+        case HANDLE_CALL_EXPRESSION: {
+            TSNode function_name;
             char *field_name = "function";
-            TSNode function_child = ts_node_child_by_field_name(root, field_name, strlen(field_name));
+            TSNode function_child = ts_node_child_by_field_name(node, field_name, strlen(field_name));
 
             // No children means the identifier with field 'function' is the function name
             if (!ts_node_is_null(function_child) && ts_node_child_count(function_child) == 0) {
@@ -184,12 +516,20 @@ void editorHighlightSubtree(TSNode root, uint32_t start_row, uint32_t end_row) {
                 function_name = ts_node_child_by_field_name(function_child, field_name, strlen(field_name));
             }
 
-            set = true;
-        } else if (!strcmp(type, "call")) {
+            if (!ts_node_is_null(function_name)) {
+                highlight = HL_FUNCTION;
+                start = ts_node_start_point(function_name);
+                end = ts_node_end_point(function_name);
+            }
+            break;
+        }
+
+        case HANDLE_CALL: {
             char *field_name = "function";
-            TSNode function_child = ts_node_child_by_field_name(root, field_name, strlen(field_name));
+            TSNode function_child = ts_node_child_by_field_name(node, field_name, strlen(field_name));
 
             if (!ts_node_is_null(function_child)) {
+                TSNode function_name;
                 int function_child_count = ts_node_child_count(function_child);
 
                 // No children means the identifier with field 'function' is the function name
@@ -202,107 +542,73 @@ void editorHighlightSubtree(TSNode root, uint32_t start_row, uint32_t end_row) {
                     function_name = ts_node_child_by_field_name(function_child, field_name, strlen(field_name));
                 }
 
-                set = true;
+                if (!ts_node_is_null(function_name)) {
+                    highlight = HL_FUNCTION;
+                    start = ts_node_start_point(function_name);
+                    end = ts_node_end_point(function_name);
+                }
             }
-        } else if (!strcmp(type, "function_item")) {
-            char *field_name = "name";
-            function_name = ts_node_child_by_field_name(root, field_name, strlen(field_name));
-            set = true;
+            break;
         }
 
-        if (set && !ts_node_is_null(function_name)) {
-            highlight = HL_FUNCTION;
-            start = ts_node_start_point(function_name);
-            end = ts_node_end_point(function_name);
+        case HANDLE_FUNCTION_ITEM: {
+            char *field_name = "name";
+            TSNode function_name = ts_node_child_by_field_name(node, field_name, strlen(field_name));
+
+            if (!ts_node_is_null(function_name)) {
+                highlight = HL_FUNCTION;
+                start = ts_node_start_point(function_name);
+                end = ts_node_end_point(function_name);
+            }
+            break;
         }
     }
 
     /*
-     * Language specific highlighting
+     * Language specific handlers
      */
-
-    // Rust
-    if (!strcmp(E.syntax->filetype, "Rust")) {
-        /*
-         * Direct
-         */
-
-        // meta item (Rust)
-        if (!strcmp(type, "meta_item")) {
-            highlight = HL_KEYWORD2;
-        }
-
-        // mutable specifier keyword (Rust)
-        else if (!strcmp(type, "mutable_specifier")) {
-            highlight = HL_KEYWORD1;
-        }
-
-        // fields (Rust)
-        else if (!strcmp(type, "field_identifier")) {
-            highlight = HL_FUNCTION;
-        }
-
-        // use list (Rust)
-        else if (!strcmp(type, "use_list")) {
-            highlight = HL_KEYWORD2;
-        }
-
-        // use wildcard * (Rust)
-        else if (!strcmp(type, "use_wildcard")) {
-            highlight = HL_NORMAL;
-        }
-
-        // enum item
-        else if (!strcmp(type, "enum_variant")) {
-            highlight = HL_CONSTANT;
-        }
-
-        /*
-         * Child
-         */
-
+    switch (class.language_handler) {
         // parameter (Rust)
-        else if (!strcmp(type, "parameter")) {
-            TSNode parameter_child = ts_node_child(root, 0);
+        case HANDLE_RUST_PARAMETER: {
+            TSNode parameter_child = ts_node_child(node, 0);
 
             if (!ts_node_is_null(parameter_child)) {
                 highlight = HL_KEYWORD1;
                 start = ts_node_start_point(parameter_child);
                 end = ts_node_end_point(parameter_child);
             }
+            break;
         }
 
         // macro name (Rust)
-        else if (!strcmp(type, "macro_invocation")) {
+        case HANDLE_RUST_MACRO_INVOCATION: {
             highlight = HL_KEYWORD2;
-            TSNode macro_child = ts_node_child(root, 0);
+            TSNode macro_child = ts_node_child(node, 0);
 
             if (!ts_node_is_null(macro_child)) {
                 start = ts_node_start_point(macro_child);
                 end = ts_node_end_point(macro_child);
                 end.column += 1;
             }
+            break;
         }
 
         // field expression (Rust)
-        else if (!strcmp(type, "field_expression")) {
+        case HANDLE_RUST_FIELD_EXPRESSION: {
             char *field_name = "field";
-            TSNode field_child = ts_node_child_by_field_name(root, field_name, strlen(field_name));
+            TSNode field_child = ts_node_child_by_field_name(node, field_name, strlen(field_name));
 
             if (!ts_node_is_null(field_child)) {
                 highlight = HL_FUNCTION;
                 start = ts_node_start_point(field_child);
                 end = ts_node_end_point(field_child);
             }
+            break;
         }
 
-        /*
-         * Complex
-         */
-
         // scoped identifier (Rust)
-        else if (inStringArray(type, (char*[]) { "scoped_identifier", "scoped_type_identifier", NULL })) {
-            TSNode parent = ts_node_parent(root);
+        case HANDLE_RUST_SCOPED_IDENTIFIER: {
+            TSNode parent = ts_node_parent(node);
 
             if (!ts_node_is_null(parent)) {
                 const char *parent_type = ts_node_type(parent);
@@ -314,13 +620,13 @@ void editorHighlightSubtree(TSNode root, uint32_t start_row, uint32_t end_row) {
                 // If parent is a use wildcard, determine highlight based on case
                 else if (!strcmp(parent_type, "use_wildcard")) {
                     char *field_name = "name";
-                    TSNode name_child = ts_node_child_by_field_name(root, field_name, strlen(field_name));
+                    TSNode name_child = ts_node_child_by_field_name(node, field_name, strlen(field_name));
 
                     TSPoint name_start = ts_node_start_point(name_child);
-                    erow *row = &E.row[name_start.row];
-                    char first = row->chars[name_start.column];
+                    TSPoint name_end = ts_node_end_point(name_child);
+                    erow row = editorRowAt(name_start.row);
 
-                    if (first >= 'A' && first <= 'Z') {
+                    if (editorMatchName(&ROW_CHARS(row)[name_start.column], name_end.column - name_start.column, NAME_CAPITALIZED)) {
                         // Uppercase
                         highlight = HL_KEYWORD2;
                     } else {
@@ -333,46 +639,45 @@ void editorHighlightSubtree(TSNode root, uint32_t start_row, uint32_t end_row) {
                 // highlighting manually should be an exception!
                 else {
                     char *field_name = "path";
-                    TSNode path_child = ts_node_child_by_field_name(root, field_name, strlen(field_name));
+                    TSNode path_child = ts_node_child_by_field_name(node, field_name, strlen(field_name));
                     TSPoint path_start = ts_node_start_point(path_child);
                     TSPoint path_end = ts_node_end_point(path_child);
 
                     // check if node is in edit range
-                    if (!(path_start.row < start_row && end.row < start_row) && 
-                        !(path_start.row > end_row && end.row > end_row)) {
-                        erow *path_row = &E.row[path_start.row];
+                    if (path_start.row >= start_row && path_start.row <= end_row) {
+                        erow path_row = editorRowAt(path_start.row);
 
                         for (uint32_t c = path_start.column; c < path_end.column; c++) {
-                            path_row->highlight[c] = HL_FUNCTION;
+                            ROW_HIGHLIGHT(path_row)[c] = HL_FUNCTION;
                         }
                     }
 
                     // if not a function
                     if (strcmp(parent_type, "call_expression")) {
                         field_name = "name";
-                        TSNode name_child = ts_node_child_by_field_name(root, field_name, strlen(field_name));
+                        TSNode name_child = ts_node_child_by_field_name(node, field_name, strlen(field_name));
 
                         TSPoint name_start = ts_node_start_point(name_child);
                         TSPoint name_end = ts_node_end_point(name_child);
 
                         // check if node is in edit range
-                        if (!(name_start.row < start_row && end.row < start_row) &&
-                            !(name_start.row > end_row && end.row > end_row)) {
-                            erow *name_row = &E.row[name_start.row];
+                        if (name_start.row >= start_row && name_start.row <= end_row) {
+                            erow name_row = editorRowAt(name_start.row);
 
-                            int hl = islower(name_row->chars[name_start.column]) ? HL_NORMAL : HL_KEYWORD2;
+                            int hl = islower(ROW_CHARS(name_row)[name_start.column]) ? HL_NORMAL : HL_KEYWORD2;
                             for (uint32_t c = name_start.column; c < name_end.column; c++) {
-                                name_row->highlight[c] = hl;
+                                ROW_HIGHLIGHT(name_row)[c] = hl;
                             }
                         }
                     }
                 }
             }
+            break;
         }
 
         // match pattern types
-        else if (!strcmp(type, "match_pattern")) {
-            TSNode match_child = ts_node_child(root, 0);
+        case HANDLE_RUST_MATCH_PATTERN: {
+            TSNode match_child = ts_node_child(node, 0);
 
             if (!ts_node_is_null(match_child)) {
                 const char *child_type = ts_node_type(match_child);
@@ -390,42 +695,36 @@ void editorHighlightSubtree(TSNode root, uint32_t start_row, uint32_t end_row) {
                     highlight = HL_KEYWORD2;
                 }
             }
+            break;
         }
-    }
 
-    // Python
-    else if (!strcmp(E.syntax->filetype, "Python")) {
         // except (Python)
-        if (!strcmp(type, "except_clause")) {
-            TSNode except_child = ts_node_child(root, 1);
+        case HANDLE_PYTHON_EXCEPT_CLAUSE: {
+            TSNode except_child = ts_node_child(node, 1);
 
             if (!ts_node_is_null(except_child)) {
                 highlight = HL_KEYWORD2;
                 start = ts_node_start_point(except_child);
                 end = ts_node_end_point(except_child);
             }
+            break;
         }
 
-        if (!strcmp(type, "keyword_argument")) {
-            TSNode keyword_arg_child = ts_node_child(root, 0);
+        case HANDLE_PYTHON_KEYWORD_ARGUMENT: {
+            TSNode keyword_arg_child = ts_node_child(node, 0);
 
             if (!ts_node_is_null(keyword_arg_child)) {
                 highlight = HL_SYNTAX1;
                 start = ts_node_start_point(keyword_arg_child);
                 end = ts_node_end_point(keyword_arg_child);
             }
+            break;
         }
 
-
-        /*
-         * Complex
-         */
-
         // Fields (Python) - atttributes without parameter list
-        else if (!strcmp(type, "attribute")) {
-
+        case HANDLE_PYTHON_ATTRIBUTE: {
             // functions can also be arguments, ignore if attribute is followed by argument list
-            TSNode sibling = ts_node_next_sibling(root);
+            TSNode sibling = ts_node_next_sibling(node);
             const char *sibling_type = "";
 
             if (!ts_node_is_null(sibling)) {
@@ -435,7 +734,7 @@ void editorHighlightSubtree(TSNode root, uint32_t start_row, uint32_t end_row) {
             // If there is no sibling or the sibling is not an argument list, find and highlight the field
             if (strcmp(sibling_type, "argument_list")) {
                 char *field_name = "attribute";
-                TSNode attribute_child = ts_node_child_by_field_name(root, field_name, strlen(field_name));
+                TSNode attribute_child = ts_node_child_by_field_name(node, field_name, strlen(field_name));
 
                 if (!ts_node_is_null(attribute_child)) {
                     highlight = HL_FIELD;
@@ -443,105 +742,52 @@ void editorHighlightSubtree(TSNode root, uint32_t start_row, uint32_t end_row) {
                     end = ts_node_end_point(attribute_child);
                 }
             }
+            break;
         }
 
-        else if (!strcmp(type, "identifier")) {
+        case HANDLE_PYTHON_IDENTIFIER: {
             // Python __XXX__ constants
+            erow row = editorRowAt(start.row);
 
-            regex_t regex;
-            int compiled_regex = regcomp(&regex, "__[[:alpha:]]+__", REG_EXTENDED);
-
-            // If successfully compiled
-            if (!compiled_regex) {
-                erow *row = &E.row[start.row];
-
-                if (!regexec(&regex, row->chars, 0, NULL, 0)) {
-                    highlight = HL_CONSTANT;
-                }
+            if (editorMatchName(&ROW_CHARS(row)[start.column], end.column - start.column, NAME_DUNDER)) {
+                highlight = HL_CONSTANT;
             }
+            break;
         }
-    }
-
-    // C
-    else if (!strcmp(E.syntax->filetype, "c")) {
-        /*
-         * Direct
-         */
-
-        // fields
-        if (!strcmp(type, "field_identifier")) {
-            highlight = HL_FIELD;
-        }
-    }
-
-    else if (!strcmp(E.syntax->filetype, "Haskell")) {
-        /*
-         * Direct
-         */
-
-        // pragma
-        if (!strcmp(type, "pragma")) {
-            highlight = HL_KEYWORD1;
-        }
-
-        // import path
-        else if (!strcmp(type, "module")) {
-            highlight = HL_FIELD;
-        }
-
-        // import item
-        else if (!strcmp(type, "import_item")) {
-            highlight = HL_NORMAL;
-        }
-
-        // type
-        else if (!strcmp(type, "constructor")) {
-            highlight = HL_FIELD;
-        }
-
-        // char
-        else if (!strcmp(type, "char")) {
-            highlight = HL_STRING;
-        }
-
-        /*
-         * Child
-         */
 
         // function (Haskell)
-        else if (!strcmp(type, "function")) {
-            TSNode function_name_child = ts_node_child(root, 0);
+        case HANDLE_HASKELL_FUNCTION: {
+            TSNode function_name_child = ts_node_child(node, 0);
 
             if (!ts_node_is_null(function_name_child)) {
                 highlight = HL_FUNCTION;
                 start = ts_node_start_point(function_name_child);
                 end = ts_node_end_point(function_name_child);
             }
+            break;
         }
 
         // type signature
-        else if (!strcmp(type, "signature")) {
-            TSNode signature_name_child = ts_node_child(root, 0);
+        case HANDLE_HASKELL_SIGNATURE: {
+            TSNode signature_name_child = ts_node_child(node, 0);
 
             if (!ts_node_is_null(signature_name_child)) {
                 highlight = HL_KEYWORD2;
                 start = ts_node_start_point(signature_name_child);
                 end = ts_node_end_point(signature_name_child);
             }
+            break;
         }
-        /*
-         * Complex
-         */
 
         // import
-        else if (!strcmp(type, "import")) {
+        case HANDLE_HASKELL_IMPORT:
             highlight = HL_FUNCTION;
             end.column = strlen("import");
-        }
+            break;
 
         // type
-        else if (!strcmp(type, "type")) {
-            TSNode sibling = ts_node_next_sibling(root);
+        case HANDLE_HASKELL_TYPE: {
+            TSNode sibling = ts_node_next_sibling(node);
 
             if (!ts_node_is_null(sibling)) {
                 const char *sibling_type = ts_node_type(sibling);
@@ -552,6 +798,7 @@ void editorHighlightSubtree(TSNode root, uint32_t start_row, uint32_t end_row) {
             } else {
                 highlight = HL_KEYWORD2;
             }
+            break;
         }
     }
 
@@ -560,39 +807,75 @@ void editorHighlightSubtree(TSNode root, uint32_t start_row, uint32_t end_row) {
         // printf("start [%d, %d]\r\n", start.row, start.column);
         // printf("end [%d, %d]\r\n", end.row, end.column);
 
-        if (!(start.row < start_row && end.row < start_row) &&
-            !(start.row > end_row && end.row > end_row)) {
-            erow *row = &E.row[start.row];
+        editorApplyHighlight(start, end, highlight, start_row, end_row);
+    }
+}
 
-            // node spans multiple lines
-            if (end.row > start.row) {
-                memset(&row->highlight[start.column], highlight, row->size - start.column);
+/*
+ * Highlight the nodes of the subtree at `root` that overlap the rows
+ * from `start_row` up to and including `end_row`.
+ * Children are ordered by position, so the cursor jumps straight to the first child
+ * reaching `start_row` and stops at the first child starting after `end_row`.
+ * Subtrees outside the rows are never visited, the cost depends on the rows and not on the size of the tree.
+ */
+void editorHighlightSubtree(TSNode root, uint32_t start_row, uint32_t end_row) {
+    if (ts_node_is_null(root)) {
+        return;
+    }
 
-                for (uint32_t r = start.row + 1; r < end.row; r++) {
-                    row = &E.row[r];
-                    memset(row->highlight, highlight, row->size);
-                }
+    editorHighlightNode(root, start_row, end_row);
 
-                row = &E.row[end.row];
-                // printf("rendersize: %d", row->renderSize);
-                // printf("end.column: %d", end.column);
-                memset(row->highlight, highlight, end.column);
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+    TSPoint start = { start_row, 0 };
+
+    // Levels below `root`, the walk ends when the cursor is back at `root`
+    int depth = 0;
+    bool descend = true;
+
+    while (true) {
+        if (descend && ts_tree_cursor_goto_first_child_for_point(&cursor, start) >= 0) {
+            depth++;
+        } else {
+            // Continue with the next sibling, or the next sibling of the closest ancestor having one
+            while (depth > 0 && !ts_tree_cursor_goto_next_sibling(&cursor)) {
+                ts_tree_cursor_goto_parent(&cursor);
+                depth--;
             }
-            // node spans single line
-            else {
-                memset(&row->highlight[start.column], highlight, end.column - start.column);
+
+            if (depth == 0) {
+                break;
             }
         }
-    }
 
-    // Highlight node children
-    for (uint32_t i = 0; i < child_count; i++) {
-        TSNode child = ts_node_child(root, i);
-        editorHighlightSubtree(child, start_row, end_row);
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+
+        // The remaining siblings start after the rows as well
+        if (ts_node_start_point(node).row > end_row) {
+            ts_tree_cursor_goto_parent(&cursor);
+            depth--;
+            descend = false;
+
+            if (depth == 0) {
+                break;
+            }
+
+            continue;
+        }
+
+        editorHighlightNode(node, start_row, end_row);
+        descend = true;
     }
+
+    ts_tree_cursor_delete(&cursor);
 }
 
 void editorHighlightSyntaxTree(int start_row, int end_row) {
+    // Languages with a highlight query are highlighted by its captures
+    if (E.syntax->query != NULL) {
+        editorHighlightQuery(start_row, end_row);
+        return;
+    }
+
     TSNode root = ts_tree_root_node(E.syntax->tree);
 
     // printf("UPDATE:\r\n");
@@ -633,13 +916,16 @@ int editorSyntaxToColor(int hl) {
 }
 
 void editorResetSyntaxHighlight(int start_row, int end_row) {
+    rowIterator it;
+    rowTreeIterate(&E.rows, start_row, &it);
+
     for (int i = start_row; i <= end_row && i < E.numrows; i++) {
-        erow *row = &E.row[i];
+        erow row = rowIteratorNext(&it);
 
         // Set correct highlighting array size
-        row->highlight = realloc(row->highlight, row->size);
+        ROW_HIGHLIGHT(row) = arenaRealloc(ROW_HIGHLIGHT(row), ROW_SIZE(row));
         // Fill array with default highlight
-        memset(row->highlight, HL_NORMAL, row->size);
+        memset(ROW_HIGHLIGHT(row), HL_NORMAL, ROW_SIZE(row));
     }
 }
 
@@ -688,58 +974,100 @@ void editorPrintSyntaxTree() {
 }
 
 void editorPrintSourceCode() {
-    for (int i = 0; i < E.numrows; i++) {
-        erow *row = &E.row[i];
-        printf("%s\r\n", row->chars);
+    rowIterator it;
+    rowTreeIterate(&E.rows, 0, &it);
+
+    erow row;
+    while (ROW_EXISTS(row = rowIteratorNext(&it))) {
+        printf("%.*s\r\n", ROW_SIZE(row), ROW_CHARS(row));
     }
 }
 
 void editorInitSyntaxTree() {
-    editorResetSyntaxHighlight(0, E.numrows);
-
+    // Without syntax highlighting rows are rendered lazily when they are first drawn
     if (E.syntax == NULL) {
-        editorCalculateRenderedRows(0, E.numrows);
-
         return;
     }
 
-    TSParser *parser = ts_parser_new();
-
-    printf("Filetype: %s\r\n", E.syntax->filetype);
+    // printf("Filetype: %s\r\n", E.syntax->filetype);
 
     if (!strcmp(E.syntax->filetype, "c")) {
         TSLanguage *tree_sitter_c();
         E.syntax->language = tree_sitter_c();
-        ts_parser_set_language(parser, E.syntax->language);
     } else if (!strcmp(E.syntax->filetype, "Python")) {
         TSLanguage *tree_sitter_python();
         E.syntax->language = tree_sitter_python();
-        ts_parser_set_language(parser, E.syntax->language);
     } else if (!strcmp(E.syntax->filetype, "Rust")) {
         TSLanguage *tree_sitter_rust();
         E.syntax->language = tree_sitter_rust();
-        ts_parser_set_language(parser, E.syntax->language);
     } else if (!strcmp(E.syntax->filetype, "Haskell")) {
         TSLanguage *tree_sitter_haskell();
         E.syntax->language = tree_sitter_haskell();
-        ts_parser_set_language(parser, E.syntax->language);
     }
 
-    int len;
-    char *source_code = editorRowsToString(&len);
+    editorInitSymbolTable();
+    editorInitKeywordTable();
+    editorLoadHighlightQuery();
 
     // editorPrintSourceCode();
 
-    TSTree *tree = ts_parser_parse_string(parser, NULL, source_code, len);
-
-    E.syntax->tree = tree;
-    E.syntax->parser = parser;
+    // The file is parsed on the parse thread, rows drawn before the tree is published are highlighted again
+    editorRequestParse();
+    editorWaitForParse(PARSE_FIRST_WAIT);
 
     // editorPrintSyntaxTree();
+}
+
+/*
+ * Drop the render and highlight of the rows from `start_row` up to and including `end_row`,
+ * so they are highlighted again when they are drawn
+ */
+void editorInvalidateHighlight(int start_row, int end_row) {
+    rowIterator it;
+    rowTreeIterate(&E.rows, start_row, &it);
+
+    for (int r = start_row; r <= end_row && r < E.numrows; r++) {
+        erow row = rowIteratorNext(&it);
 
-    editorHighlightSyntaxTree(0, E.numrows);
+        arenaFree(ROW_RENDER(row));
+        arenaFree(ROW_HIGHLIGHT(row));
+        ROW_RENDER(row) = NULL;
+        ROW_HIGHLIGHT(row) = NULL;
+    }
+}
+
+/*
+ * Highlight and render the rows from `start_row` up to and including `end_row` that have not been rendered yet.
+ * Each run of consecutive unrendered rows is highlighted with a single walk of the syntax tree.
+ */
+void editorHighlightRows(int start_row, int end_row) {
+    if (end_row >= E.numrows) {
+        end_row = E.numrows - 1;
+    }
+
+    rowIterator it;
+    rowTreeIterate(&E.rows, start_row, &it);
 
-    editorCalculateRenderedRows(0, E.numrows);
+    int run_start = -1;
+    for (int r = start_row; r <= end_row + 1; r++) {
+        bool rendered = true;
+        if (r <= end_row) {
+            erow row = rowIteratorNext(&it);
+            rendered = ROW_RENDER(row) != NULL;
+        }
+
+        if (!rendered && run_start == -1) {
+            run_start = r;
+        } else if (rendered && run_start != -1) {
+            if (E.syntax != NULL && E.syntax->tree != NULL) {
+                editorResetSyntaxHighlight(run_start, r - 1);
+                editorHighlightSyntaxTree(run_start, r - 1);
+            }
+
+            editorCalculateRenderedRows(run_start, r - 1);
+            run_start = -1;
+        }
+    }
 }
 
 TSPoint createTSPoint(int row, int col) {
@@ -768,47 +1096,12 @@ void editorUpdateSyntaxHighlight(int old_end_row, int old_end_column, int old_en
     int first_changed_row = edit.start_point.row;
     int last_changed_row = new_end_row > old_end_row ? new_end_row : old_end_row;
 
+    // The edit is parsed with the other edits of the frame, see editorParseEdits.
+    // Until the parse thread publishes the new tree the edited rows are highlighted with the edited old tree.
     if (E.syntax != NULL) {
-        // Edit the syntax tree to keep in in sync with the edited sourcecode
-        // (see https://tree-sitter.github.io/tree-sitter/using-parsers#editing)
-        ts_tree_edit(E.syntax->tree, &edit);
-
-        int len;
-        char *source_code = editorRowsToString(&len);
-
-        // editorPrintSourceCode();
-
-        TSTree *tree = ts_parser_parse_string(E.syntax->parser, E.syntax->tree, source_code, len);
-
-        // Get change ranges
-        uint32_t range_len;
-        TSRange *changed_range = ts_tree_get_changed_ranges(E.syntax->tree, tree, &range_len);
-
-        // Since we update the syntax tree after every edit, there should be 1 or 0 change ranges.
-        // If the syntax tree does not change, there are 0 change ranges.
-        if (range_len > 1) {
-            die("Changed range array length should always be 1 or less");
-        } else if (range_len == 1) {
-            TSRange range = changed_range[0];
-
-            E.syntax->tree = tree;
-
-            first_changed_row = range.start_point.row;
-            last_changed_row = range.end_point.row;
-        }
-
-        free(changed_range);
-
-        // editorPrintSyntaxTree();
-
-        // Reset highlight for changed rows
-        editorResetSyntaxHighlight(first_changed_row, last_changed_row);
-
-        editorHighlightSyntaxTree(first_changed_row, last_changed_row);
-    } else {
-        // Reset highlight for changed rows
-        editorResetSyntaxHighlight(first_changed_row, last_changed_row);
+        editorEditSyntaxTree(&edit);
     }
 
-    editorCalculateRenderedRows(first_changed_row, last_changed_row);
+    // The edited rows are highlighted once when they are drawn, not once per edit
+    editorInvalidateHighlight(first_changed_row, last_changed_row);
 }
@@ -21,12 +21,79 @@ enum editorHighlight {
     HL_SYNTAX2,
     HL_CONSTANT,
     HL_FIELD,
+    // Selected search match, only drawn over the highlight of the rows
+    HL_MATCH_SELECTED,
+    // Number of highlight classes
+    HL_COUNT,
 };
 
+/*
+ * How the highlight of a syntax tree node is refined when it depends on more than the node's symbol,
+ * e.g. on the node's children or text
+ */
+enum editorSymbolHandler {
+    // The highlight only depends on the symbol
+    HANDLE_NONE = 0,
+
+    // Language agnostic
+    HANDLE_FIRST_CHARACTER,
+    HANDLE_RETURN,
+    HANDLE_IDENTIFIER,
+    HANDLE_FUNCTION_DECLARATOR,
+    HANDLE_CALL_EXPRESSION,
+    HANDLE_CALL,
+    HANDLE_FUNCTION_ITEM,
+
+    // Rust
+    HANDLE_RUST_PARAMETER,
+    HANDLE_RUST_MACRO_INVOCATION,
+    HANDLE_RUST_FIELD_EXPRESSION,
+    HANDLE_RUST_SCOPED_IDENTIFIER,
+    HANDLE_RUST_MATCH_PATTERN,
+
+    // Python
+    HANDLE_PYTHON_EXCEPT_CLAUSE,
+    HANDLE_PYTHON_KEYWORD_ARGUMENT,
+    HANDLE_PYTHON_ATTRIBUTE,
+    HANDLE_PYTHON_IDENTIFIER,
+
+    // Haskell
+    HANDLE_HASKELL_FUNCTION,
+    HANDLE_HASKELL_SIGNATURE,
+    HANDLE_HASKELL_IMPORT,
+    HANDLE_HASKELL_TYPE,
+};
+
+/*
+ * Patterns identifiers are classified by, see editorMatchName
+ */
+enum editorNamePattern {
+    // Digits, capital letters and underscores, at least two characters
+    NAME_CONSTANT,
+    // Letters surrounded by double underscores
+    NAME_DUNDER,
+    // Starts with a capital letter
+    NAME_CAPITALIZED,
+    // Keyword1 or keyword2 of the current language, see editorKeywordHighlight
+    NAME_KEYWORD1,
+    NAME_KEYWORD2,
+};
+
+/*
+ * Return the `editorNamePattern` called `name`, -1 if there is none
+ */
+int editorNamePatternFor(const char *name);
+
+/*
+ * Returns `true` if the `length` characters at `name` (e.g. an identifier in a row) match `pattern`.
+ * Only looks at the characters of the name, does not allocate and does not need NUL terminated text.
+ */
+bool editorMatchName(const char *name, uint32_t length, enum editorNamePattern pattern);
+
 /*
  * Calculate syntax highlighting for the given `row`
  */
-void editorUpdateSyntax(erow *row);
+void editorUpdateSyntax(erow row);
 
 /*
  * Convert `editorHighlight` constant `hl` to ANSI escape code number
@@ -39,10 +106,33 @@ int editorSyntaxToColor(int hl);
  */
 void editorSelectSyntaxHighlight();
 
+/*
+ * Set the highlight of the characters from `start` up to `end` to `highlight`,
+ * only changing the rows from `start_row` up to and including `end_row`
+ */
+void editorApplyHighlight(TSPoint start, TSPoint end, int highlight, uint32_t start_row, uint32_t end_row);
+
+/*
+ * Build the table mapping every symbol of the current language to its highlighting
+ */
+void editorInitSymbolTable();
+
 void editorInitSyntaxTree();
 
+/*
+ * Drop the render and highlight of the rows from `start_row` up to and including `end_row`,
+ * so they are highlighted again when they are drawn
+ */
+void editorInvalidateHighlight(int start_row, int end_row);
+
 void editorUpdateSyntaxHighlight(int old_end_row, int old_end_column, int old_end_byte, int new_end_row, int new_end_column, int new_end_byte);
 
 void editorHighlightSyntaxTree();
 
+/*
+ * Highlight and render the rows from `start_row` up to and including `end_row` that have not been rendered yet.
+ * Each run of consecutive unrendered rows is highlighted with a single walk of the syntax tree.
+ */
+void editorHighlightRows(int start_row, int end_row);
+
 #endif
@@ -1,10 +1,13 @@
 #include "editor.h"
 #include "input.h"
 #include "io.h"
+#include "lineindex.h"
+#include "parse.h"
 #include "render.h"
 #include "search.h"
 #include "terminal.h"
 #include <errno.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -13,15 +16,37 @@
 
 extern struct editorConfig E;
 
+/*
+ * Characters read from the terminal after the end of a bracketed paste, they are read as keys before the terminal
+ */
+struct editorTypeahead {
+    char chars[PASTE_BLOCK_SIZE];
+    size_t len;
+    size_t pos;
+};
+
+struct editorTypeahead TA = { {0}, 0, 0 };
+
+/*
+ * Read a character like getch(), the characters read past the end of a bracketed paste come first
+ */
+int editorGetch() {
+    if (TA.pos < TA.len) {
+        return (unsigned char)TA.chars[TA.pos++];
+    }
+
+    return getch();
+}
+
 /*
  * Move cursor based on pressed `key`.
  * When moving up and down the cursor will attempt to stay at the same column.
  * The cursor will also stick to the end of line when moving up and down.
  */
 void editorMoveCursor(int key) {
-    // Get current row using cursor position, NULL if on extra row at the end
-    erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
-    int rowLen = row ? row->size : 0;
+    // Get current row using cursor position, ROW_NONE if on extra row at the end
+    erow row = editorRowAt(E.cy);
+    int rowLen = ROW_EXISTS(row) ? ROW_SIZE(row) : 0;
 
     switch (key) {
         case LEFT:
@@ -51,7 +76,7 @@ void editorMoveCursor(int key) {
             break;
         case RIGHT:
             // Only scroll to the right if we have not reached the end of the current row
-            if (row && E.cx < rowLen) {
+            if (ROW_EXISTS(row) && E.cx < rowLen) {
                 E.cx++;
                 E.savedCx = E.cx;
             }
@@ -65,10 +90,13 @@ void editorMoveCursor(int key) {
             break;
     }
 
+    // Wait for the background indexer when moving past the rows indexed so far
+    editorWaitForRow(E.cy);
+
     // Get new row
-    erow *newRow = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+    erow newRow = editorRowAt(E.cy);
     // Get new row length
-    int newRowLen = newRow ? newRow->size : 0;
+    int newRowLen = ROW_EXISTS(newRow) ? ROW_SIZE(newRow) : 0;
 
     // If we're scrolling up/down at the end of the line, keep the cursor at the end of the line
     if (E.savedCx == -1) {
@@ -92,9 +120,9 @@ void editorMoveCursor(int key) {
 }
 
 void editorJumpWord(int direction) {
-    // Get current row using cursor position, NULL if on extra row at the end
-    erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
-    int rowLen = row ? row->size : 0;
+    // Get current row using cursor position, ROW_NONE if on extra row at the end
+    erow row = editorRowAt(E.cy);
+    int rowLen = ROW_EXISTS(row) ? ROW_SIZE(row) : 0;
 
     switch (direction) {
         // Jump to next separator on C-Left
@@ -156,18 +184,131 @@ void editorHandleMouseEvent(MEVENT event) {
     else {
         // printw("x: %d, y: %d, z: %d\\\\n", event.x, event.y, event.z);
         E.cy = event.y + E.row_offset;
-        E.cx = editorRowRxtoCx(&E.row[E.cy], event.x - E.line_nr_len);
+        editorWaitForRow(E.cy);
+        if (E.cy > E.numrows) {
+            E.cy = E.numrows;
+        }
+
+        erow row = editorRowAt(E.cy);
+        E.cx = ROW_EXISTS(row) ? editorRowRxtoCx(row, event.x - E.line_nr_len) : 0;
 
         E.savedCx = E.cx;
     }
 }
 
+/*
+ * Read the rest of an escape sequence after ESC and return its key, ESC if the characters are not a known sequence.
+ * Terminals send a sequence at once, so when nothing follows within the timeout of the caller ESC was pressed alone.
+ */
+int editorReadEscapeSequence() {
+    char seq[5];
+
+    int x = editorGetch();
+    int y = editorGetch();
+    seq[0] = x;
+    seq[1] = y;
+    if (x == ERR || y == ERR) {
+        return '\x1b';
+    }
+
+    if (seq[0] == '[') {
+        if (seq[1] >= '0' && seq[1] <= '9') {
+            int z = editorGetch();
+            seq[2] = z;
+            if (z == ERR) {
+                return '\x1b';
+            }
+
+            // Keys typed right after a paste are read from the typeahead, curses did not turn them into keys
+            if (seq[2] == '~') {
+                switch (seq[1]) {
+                    case '1': return HOME;
+                    case '3': return DELETE;
+                    case '4': return END;
+                    case '5': return PAGE_UP;
+                    case '6': return PAGE_DOWN;
+                }
+            }
+
+            // Start of a bracketed paste (ESC[200~), the end (ESC[201~) is normally read by editorPaste
+            if (seq[1] == '2' && seq[2] == '0') {
+                int a = editorGetch();
+                int b = editorGetch();
+                seq[3] = a;
+                seq[4] = b;
+                if (a == ERR || b == ERR) {
+                    return '\x1b';
+                }
+
+                if (seq[3] == '0' && seq[4] == '~') {
+                    return PASTE;
+                }
+
+                // End of text pasted into a prompt, which reads the pasted text key by key
+                if (seq[3] == '1' && seq[4] == '~') {
+                    return NO_KEY;
+                }
+
+                return '\x1b';
+            }
+
+            if (seq[2] == ';') {
+                int a = editorGetch();
+                int b = editorGetch();
+                seq[3] = a;
+                seq[4] = b;
+                if (a == ERR || b == ERR) {
+                    return '\x1b';
+                }
+
+                // Ctrl-Left
+                else if (seq[3] == '5' && seq[4] == 'D') {
+                    return C_LEFT;
+                }
+
+                // Ctrl-Right
+                else if (seq[3] == '5' && seq[4] == 'C') {
+                    return C_RIGHT;
+                }
+            }
+        }
+    }
+
+    // Cursor keys, sent as ESC O A while curses has the terminal in keypad mode
+    if (seq[0] == '[' || seq[0] == 'O') {
+        switch (seq[1]) {
+            case 'A': return UP;
+            case 'B': return DOWN;
+            case 'C': return RIGHT;
+            case 'D': return LEFT;
+            case 'H': return HOME;
+            case 'F': return END;
+        }
+    }
+
+    return '\x1b';
+}
+
 /*
  * Continuously attempt to read and return input
  */
 int editorReadKey() {
+    // Keep redrawing while the file is being indexed, parsed, searched or saved in the background
+    int delay = -1;
+    if (editorIndexing()) {
+        delay = LINE_INDEX_INPUT_TIMEOUT;
+    } else if (editorParsing()) {
+        delay = PARSE_INPUT_TIMEOUT;
+    } else if (editorSearching()) {
+        delay = SEARCH_INPUT_TIMEOUT;
+    } else if (editorSaving()) {
+        delay = SAVE_INPUT_TIMEOUT;
+    }
+
+    timeout(delay);
+
     int ch;
-    ch = getch();
+    ch = editorGetch();
 
     if (ch == KEY_MOUSE) {
         MEVENT event;
@@ -176,7 +317,7 @@ int editorReadKey() {
             editorHandleMouseEvent(event);
         }
 
-        return '\\x1b';
+        return '\x1b';
     }
 
     switch (ch) {
@@ -191,53 +332,147 @@ int editorReadKey() {
         case KEY_RIGHT: return RIGHT;
     }
 
-    if (ch == '\\x1b') {
-        char seq[5];
+    if (ch == '\x1b') {
+        // Don't wait for keys after ESC pressed alone, then restore the timeout for the next key
+        timeout(ESCAPE_SEQUENCE_TIMEOUT);
+        int key = editorReadEscapeSequence();
+        timeout(delay);
 
-        int x = getch();
-        int y = getch();
-        seq[0] = x;
-        seq[1] = y;
-        if (x == ERR || y == ERR) {
-            return '\\x1b';
+        return key;
+    }
+
+    if (ch != ERR) {
+        return ch;
+    } else {
+        return NO_KEY;
+    }
+}
+
+/*
+ * Return the number of characters of the paste end marker matched after `ch`, `matched` were matched before it
+ */
+size_t editorMatchPasteEnd(const char *end_marker, size_t matched, int ch) {
+    // The marker starts with the only escape character in it, so a mismatch can only restart the match
+    if (ch == end_marker[matched]) {
+        return matched + 1;
+    }
+
+    return ch == end_marker[0] ? 1 : 0;
+}
+
+/*
+ * Read the text of a bracketed paste up to the end marker and insert it as a single edit.
+ * What curses already read is taken from it first, the rest is read from the terminal in large blocks.
+ * Characters after the end marker are kept for editorReadKey, so keys typed after the paste stay behind it.
+ */
+void editorPaste() {
+    const char *end_marker = "\x1b[201~";
+    size_t marker_len = strlen(end_marker);
+
+    size_t len = 0;
+    size_t capacity = 65536;
+    char *text = malloc(capacity);
+
+    // Number of characters of the end marker matched by the last characters read
+    size_t matched = 0;
+
+    // Pasted escape sequences are text, they must not be turned into keys
+    keypad(stdscr, FALSE);
+    timeout(0);
+
+    // Curses reads a character per system call, which takes seconds for large pastes. Only the characters it may
+    // have read ahead (at most its ungetch queue) are taken from it, after the typeahead that came before them.
+    int queued = 0;
+    while (matched < marker_len && queued < PASTE_CURSES_QUEUE) {
+        if (TA.pos == TA.len) {
+            queued++;
         }
 
-        if (seq[0] == '[') {
-            if (seq[1] >= '0' && seq[1] <= '9') {
-                int z = getch();
-                seq[2] = z;
-                if (z == ERR) {
-                    return '\\x1b';
-                }
+        int ch = editorGetch();
+        if (ch == ERR) {
+            break;
+        }
 
-                if (seq[2] == ';') {
-                    int a = getch();
-                    int b = getch();
-                    seq[3] = a;
-                    seq[4] = b;
-                    if (a == ERR || b == ERR) {
-                        return '\\x1b';
-                    }
-
-                    // Ctrl-Left
-                    else if (seq[3] == '5' && seq[4] == 'D') {
-                        return C_LEFT;
-                    }
-
-                    // Ctrl-Right
-                    else if (seq[3] == '5' && seq[4] == 'C') {
-                        return C_RIGHT;
-                    }
-                }
+        if (len == capacity) {
+            capacity *= 2;
+            text = realloc(text, capacity);
+        }
+
+        text[len++] = ch;
+        matched = editorMatchPasteEnd(end_marker, matched, ch);
+    }
+
+    keypad(stdscr, TRUE);
+
+    char block[PASTE_BLOCK_SIZE];
+
+    while (matched < marker_len) {
+        // The terminal sends the pasted text right after the start marker, stop waiting if the end marker never arrives
+        struct pollfd input = { STDIN_FILENO, POLLIN, 0 };
+        int ready = poll(&input, 1, PASTE_TIMEOUT);
+        if (ready == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if (ready <= 0) {
+            break;
+        }
+
+        ssize_t count = read(STDIN_FILENO, block, sizeof(block));
+        if (count == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if (count <= 0) {
+            break;
+        }
+
+        if (len + count > capacity) {
+            while (len + count > capacity) {
+                capacity *= 2;
             }
+
+            text = realloc(text, capacity);
         }
+
+        ssize_t i = 0;
+        while (i < count && matched < marker_len) {
+            text[len++] = block[i];
+            matched = editorMatchPasteEnd(end_marker, matched, block[i]);
+            i++;
+        }
+
+        // The typeahead was read empty before the terminal was read
+        memcpy(TA.chars, &block[i], count - i);
+        TA.len = count - i;
+        TA.pos = 0;
     }
 
-    if (ch != ERR) {
-        return ch;
-    } else {
-        return '\\x1b';
+    if (matched == marker_len) {
+        len -= marker_len;
+    }
+
+    editorInsertText(text, len);
+    free(text);
+}
+
+/*
+ * Returns `true` if a key can be read without waiting, e.g. the rest of pasted text
+ */
+bool editorKeyPending() {
+    if (TA.pos < TA.len) {
+        return true;
     }
+
+    timeout(0);
+    int ch = getch();
+
+    if (ch == ERR) {
+        return false;
+    }
+
+    ungetch(ch);
+    return true;
 }
 
 /*
@@ -246,12 +481,22 @@ int editorReadKey() {
 void editorProcessKeypress() {
     int c = editorReadKey();
 
+    // Nothing to do, the screen is redrawn on the next iteration
+    if (c == NO_KEY) {
+        return;
+    }
+
     switch (c) {
         case '\r':
             editorInsertNewline();
             break;
 
+        case PASTE:
+            editorPaste();
+            break;
+
         case CTRL_KEY('r'):
+            editorInvalidateFrame();
             editorRefreshScreen();
             break;
 
@@ -266,6 +511,9 @@ void editorProcessKeypress() {
 
         // Quit on C-d
         case CTRL_KEY('d'):
+            // Let a running save finish, the file is unsaved if it fails
+            editorWaitForSave();
+
             if (E.dirty && !E.forceQuit) {
                 editorSetStatusMessage("WARNING!!! File has unsaved changes. "
                         "Press Ctrl-d again to quit.");
@@ -297,8 +545,8 @@ void editorProcessKeypress() {
         case END:
             {
                 //E.cx = E.screencols - 1;
-                erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
-                int rowLen = row ? row->size : 0;
+                erow row = editorRowAt(E.cy);
+                int rowLen = ROW_EXISTS(row) ? ROW_SIZE(row) : 0;
                 E.cx = rowLen;
                 E.savedCx = E.cx;
             }
@@ -347,6 +595,11 @@ void editorProcessKeypress() {
             editorJumpWord(c);
             break;
 
+        // Toggle relative line numbers on C-n
+        case CTRL_KEY('n'):
+            E.relative_line_nrs = !E.relative_line_nrs;
+            break;
+
         case CTRL_KEY('l'):
         case '\x1b':
             break;
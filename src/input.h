@@ -1,9 +1,33 @@
 #ifndef INPUT_H
 #define INPUT_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
 /* Get Ctrl key code by setting the upper 3 bits to 0 */
 #define CTRL_KEY(k) ((k) & 0x1f)
 
+/*
+ * Time (in milliseconds) to wait for the rest of a bracketed paste before inserting what arrived so far
+ */
+#define PASTE_TIMEOUT 500
+
+/*
+ * Number of characters of a bracketed paste read from the terminal at once
+ */
+#define PASTE_BLOCK_SIZE 65536
+
+/*
+ * Number of characters of a bracketed paste read through curses before the terminal is read directly,
+ * enough for the characters curses read ahead (its ungetch queue is smaller)
+ */
+#define PASTE_CURSES_QUEUE 256
+
+/*
+ * Time (in milliseconds) to wait for the rest of an escape sequence, ESC is handled as a key of its own after that
+ */
+#define ESCAPE_SEQUENCE_TIMEOUT 50
+
 enum editorKey {
     //LEFT = 'h',
     //DOWN = 'j',
@@ -21,13 +45,45 @@ enum editorKey {
     PAGE_DOWN,
     C_LEFT,
     C_RIGHT,
+    // Start of a bracketed paste, the pasted text follows
+    PASTE,
+    // No key was pressed before the input timeout
+    NO_KEY,
 };
 
+/*
+ * Read a character like getch(), the characters read past the end of a bracketed paste come first
+ */
+int editorGetch();
+
+/*
+ * Return the number of characters of the paste end marker matched after `ch`, `matched` were matched before it
+ */
+size_t editorMatchPasteEnd(const char *end_marker, size_t matched, int ch);
+
+/*
+ * Read the text of a bracketed paste up to the end marker and insert it as a single edit.
+ * What curses already read is taken from it first, the rest is read from the terminal in large blocks.
+ * Characters after the end marker are kept for editorReadKey, so keys typed after the paste stay behind it.
+ */
+void editorPaste();
+
+/*
+ * Returns `true` if a key can be read without waiting, e.g. the rest of pasted text
+ */
+bool editorKeyPending();
+
 /*
  * Read input and decide what to do with it
  */
 void editorProcessKeypress();
 
+/*
+ * Read the rest of an escape sequence after ESC and return its key, ESC if the characters are not a known sequence.
+ * Terminals send a sequence at once, so when nothing follows within the timeout of the caller ESC was pressed alone.
+ */
+int editorReadEscapeSequence();
+
 /*
  * Continuously attempt to read and return input
  */
@@ -6,60 +6,202 @@
 
 #include "editor.h"
 #include "highlight.h"
+#include "io.h"
+#include "lineindex.h"
 #include "prompt.h"
 #include "terminal.h"
 #include <errno.h>
 #include <fcntl.h>
+#include <libgen.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 extern struct editorConfig E;
 
+/*
+ * State of the background save
+ */
+struct editorSaveState {
+    pthread_t thread;
+    // Protects `done`, `result` and `error`
+    pthread_mutex_t lock;
+
+    // Set while a save has not been finished (only used by the editor thread)
+    bool running;
+
+    // Set by the save thread when the file is written
+    bool done;
+    int result;
+    int error;
+
+    char *filename;
+
+    // Rows when the save started, the row tree copies what is modified while the snapshot is written
+    rowSnapshot rows;
+};
+
+struct editorSaveState S = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
 /*** file i/o ***/
 
 /*
- * Converts the editor's rows to a string.
- * Stores the length of the string in `bufferLength`
+ * Write all `count` buffers of `iov` to `fd`, continuing after partial writes.
+ * Returns -1 on error.
  */
-char *editorRowsToString(int *bufferLength) {
-    int totalLength = 0;
-    for (int i = 0; i < E.numrows; i++) {
-        totalLength += E.row[i].size + 1;
+int editorWriteAll(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        // Skip the buffers that were written completely
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+
+        // Continue in the middle of a partially written buffer
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
     }
 
-    // Create buffer to hold string
-    char *buf = malloc(totalLength);
+    return 0;
+}
+
+/*
+ * Stream the rows of snapshot `rows` to `fd`, each row followed by a newline.
+ * The rows are written straight from their buffers in batches of SAVE_BATCH_ROWS rows,
+ * one leaf of the snapshot at a time, so memory use does not depend on the size of the file.
+ * Returns -1 on error.
+ */
+int editorWriteRows(int fd, const rowSnapshot *rows) {
+    static char newline = '\n';
+    struct iovec iov[SAVE_BATCH_ROWS * 2];
+    int count = 0;
+
+    int row = 0;
+    while (row < rows->count) {
+        // The links between leaves are not part of the snapshot, every leaf is found from the root
+        int slot;
+        rowLeaf *leaf = rowSnapshotLeaf(rows, row, &slot);
+
+        for (; slot < leaf->count; slot++) {
+            iov[count].iov_base = leaf->chars[slot];
+            iov[count].iov_len = leaf->size[slot];
+            count++;
+
+            iov[count].iov_base = &newline;
+            iov[count].iov_len = 1;
+            count++;
+
+            if (count == SAVE_BATCH_ROWS * 2) {
+                if (editorWriteAll(fd, iov, count) == -1) {
+                    return -1;
+                }
 
-    // Copy each row to the string
-    char *p = buf;
-    for (int i = 0; i < E.numrows; i++) {
-        memcpy(p, E.row[i].chars, E.row[i].size);
-        p += E.row[i].size;
-        // Add a newline after each row
-        *p = '\n';
-        p++;
+                count = 0;
+            }
+
+            row++;
+        }
     }
 
-    *bufferLength = totalLength;
-    return buf;
+    return editorWriteAll(fd, iov, count);
 }
 
 /*
- * Read the content of `filename` into the editor
+ * Write the rows of snapshot `rows` to a temporary file next to `filename`, flush it to disk
+ * and rename it over `filename`, so the file is never left partially written.
+ * Returns -1 on error, with `errno` set.
  */
-void editorOpen(char *filename) {
-    free(E.filename);
-    E.filename = strdup(filename);
+int editorWriteFile(char *filename, const rowSnapshot *rows) {
+    // Replace the file a symbolic link points to, not the link itself
+    char *path = realpath(filename, NULL);
+    if (path == NULL) {
+        // The file does not exist yet
+        path = strdup(filename);
+    }
 
-    editorSelectSyntaxHighlight();
+    // The temporary file is in the same directory, so it can be renamed over the file
+    size_t pathLength = strlen(path);
+    char *tmp = malloc(pathLength + sizeof(".XXXXXX"));
+    memcpy(tmp, path, pathLength);
+    memcpy(&tmp[pathLength], ".XXXXXX", sizeof(".XXXXXX"));
 
-    FILE *fp = fopen(filename , "r");
-    if (!fp) {
-        die("fopen failed");
+    int fd = mkstemp(tmp);
+    if (fd == -1) {
+        free(tmp);
+        free(path);
+        return -1;
+    }
+
+    // Keep the permissions of the replaced file, new files get the default permissions
+    mode_t mode;
+    struct stat st;
+    if (stat(path, &st) != -1) {
+        mode = st.st_mode & 07777;
+    } else {
+        mode_t mask = umask(0);
+        umask(mask);
+        mode = 0644 & ~mask;
+    }
+
+    int result = 0;
+    if (fchmod(fd, mode) == -1 || editorWriteRows(fd, rows) == -1 || fsync(fd) == -1) {
+        result = -1;
+    }
+
+    if (close(fd) == -1) {
+        result = -1;
+    }
+
+    if (result == 0 && rename(tmp, path) == -1) {
+        result = -1;
+    }
+
+    if (result == -1) {
+        int error = errno;
+        unlink(tmp);
+        errno = error;
+    } else {
+        // Flush the directory entry, so the rename survives a crash
+        char *dir = strdup(path);
+        int dirfd = open(dirname(dir), O_RDONLY);
+        if (dirfd != -1) {
+            fsync(dirfd);
+            close(dirfd);
+        }
+        free(dir);
     }
 
+    free(tmp);
+    free(path);
+
+    return result;
+}
+
+/*
+ * Read the content of file `fp` line by line into the editor,
+ * used for files that cannot be memory mapped
+ */
+void editorReadRows(FILE *fp) {
     char *line = NULL;
     size_t linecap = 0;
     ssize_t linelen;
@@ -77,16 +219,159 @@ void editorOpen(char *filename) {
         }
     }
 
-    editorInitSyntaxTree();
-
     free(line);
+}
+
+/*
+ * Split the memory mapped file into rows, the rows point into the mapping
+ */
+void editorMapRows() {
+    char *p = E.map;
+    char *end = E.map + E.mapSize;
+
+    while (p < end) {
+        char *newline = memchr(p, '\n', end - p);
+        char *line_end = newline ? newline : end;
+
+        // Do not include carriage returns in line length
+        size_t linelen = line_end - p;
+        while (linelen > 0 && p[linelen - 1] == '\r') {
+            linelen--;
+        }
+
+        // Append row of size linelen
+        editorInsertMappedRow(E.numrows, p, linelen);
+
+        p = newline ? newline + 1 : end;
+    }
+}
+
+/*
+ * Read the content of `filename` into the editor.
+ * Regular files are memory mapped, rows reference the mapping until they are modified.
+ * Large files are split into rows on a background thread, so the first rows can be drawn right away.
+ */
+void editorOpen(char *filename) {
+    free(E.filename);
+    E.filename = strdup(filename);
+
+    editorSelectSyntaxHighlight();
+
+    FILE *fp = fopen(filename , "r");
+    if (!fp) {
+        die("fopen failed");
+    }
+
+    struct stat st;
+    if (fstat(fileno(fp), &st) != -1 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        E.map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+
+        if (E.map == MAP_FAILED) {
+            E.map = NULL;
+        } else {
+            E.mapSize = st.st_size;
+        }
+    }
+
+    if (E.map && E.mapSize >= LINE_INDEX_BACKGROUND_SIZE) {
+        // The syntax tree is initialized once the indexer is done
+        editorStartLineIndex();
+    } else if (E.map) {
+        editorMapRows();
+    } else {
+        editorReadRows(fp);
+    }
+
+    // The mapping stays valid after closing the file
     fclose(fp);
+
+    if (!editorIndexing()) {
+        editorInitSyntaxTree();
+    }
+
     E.dirty = false;
 }
 
+/*** background save ***/
+
+/*
+ * Background thread: write the snapshot of the rows to the file
+ */
+void *editorSaveWorker(void *arg) {
+    (void)arg;
+
+    int result = editorWriteFile(S.filename, &S.rows);
+    int error = errno;
+
+    pthread_mutex_lock(&S.lock);
+    S.result = result;
+    S.error = error;
+    S.done = true;
+    pthread_mutex_unlock(&S.lock);
+
+    return NULL;
+}
+
+/*
+ * Join the save thread, release the snapshot and report the result
+ */
+void editorSaveComplete() {
+    pthread_join(S.thread, NULL);
+    S.running = false;
+
+    // Nodes and characters of rows changed while they were written can be freed once no parse reads them either
+    rowTreeReleaseSnapshot(&E.rows, &S.rows);
+    editorFreeDeferred();
+
+    free(S.filename);
+    S.filename = NULL;
+
+    if (S.result == -1) {
+        // The changes are not on disk
+        E.dirty = true;
+        editorSetStatusMessage("Couldn't save! I/O error: %s", strerror(S.error));
+    } else {
+        editorSetStatusMessage("%ld bytes written to disk", S.rows.bytes);
+    }
+}
+
+/*
+ * Finish the background save if the save thread is done
+ */
+void editorPollSave() {
+    if (!S.running) {
+        return;
+    }
+
+    pthread_mutex_lock(&S.lock);
+    bool done = S.done;
+    pthread_mutex_unlock(&S.lock);
+
+    if (done) {
+        editorSaveComplete();
+    }
+}
+
+/*
+ * Wait for the background save to finish
+ */
+void editorWaitForSave() {
+    if (S.running) {
+        editorSaveComplete();
+    }
+}
+
+/*
+ * Returns `true` while a background save is running
+ */
+bool editorSaving() {
+    return S.running;
+}
+
 /*
  * Save the editor content to the opened file.
  * If no filename is set, prompt the user for one.
+ * The rows are written by a background thread, so the user can keep editing while the file is saved.
  */
 void editorSave() {
     // Prompt user for filename if there is none yet
@@ -101,29 +386,29 @@ void editorSave() {
         editorSelectSyntaxHighlight();
     }
 
-    // Get editor text and its length
-    int len;
-    char *buf = editorRowsToString(&len);
-
-    // Open (or create) the file
-    int fd = open(E.filename, O_RDWR | O_CREAT, 0644);
-    if (fd != -1) {
-        // Set file length to len
-        if (ftruncate(fd, len) != -1) {
-            // Write buf to file
-            if (write(fd, buf, len) != -1) {
-                close(fd);
-                free(buf);
-                E.dirty = false;
-                editorSetStatusMessage("%d bytes written to disk", len);
-                return;
-            }
-        }
-        close(fd);
+    // Save the whole file, not only the rows indexed so far
+    editorFinishIndexing();
+
+    // Only one save at a time
+    editorWaitForSave();
+
+    // Snapshot the rows in O(1): the row tree copies the nodes and rows that are modified while the save thread
+    // writes them and frees the old ones after the save (see rowTreeSnapshot), so the user can keep editing.
+    rowTreeSnapshot(&E.rows, &S.rows);
+
+    // The file is replaced by a new one, the rows can keep pointing into the mapping of the old file
+    S.filename = strdup(E.filename);
+    S.done = false;
+
+    if (pthread_create(&S.thread, NULL, editorSaveWorker, NULL) != 0) {
+        die("pthread_create");
     }
 
-    free(buf);
-    editorSetStatusMessage("Couldn't save! I/O error: %s", strerror(errno));
+    S.running = true;
+
+    // Edits made from now on mark the buffer as modified again
+    E.dirty = false;
+    editorSetStatusMessage("Saving...");
 }
 
 
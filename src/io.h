@@ -1,20 +1,55 @@
-#ifndef FILENAME_H
-#define FILENAME_H
+#ifndef IO_H
+#define IO_H
+
+#include "buffer.h"
+#include <stdbool.h>
+
+/*
+ * Number of rows written with a single writev call when saving
+ */
+#define SAVE_BATCH_ROWS 512
+
+/*
+ * Input timeout (in milliseconds) while saving in the background, so the result is shown without waiting for a key
+ */
+#define SAVE_INPUT_TIMEOUT 100
+
+/*
+ * Stream the rows of snapshot `rows` to `fd`, each row followed by a newline.
+ * Returns -1 on error.
+ */
+int editorWriteRows(int fd, const rowSnapshot *rows);
 
 /*
- * Converts the editor's rows to a string.
- * Stores the length of the string in `bufferLength`
+ * Write the rows of snapshot `rows` to a temporary file next to `filename`, flush it to disk
+ * and rename it over `filename`. Returns -1 on error, with `errno` set.
  */
-char *editorRowsToString(int *bufferLength);
+int editorWriteFile(char *filename, const rowSnapshot *rows);
 
 /*
  * Read the content of `filename` into the editor
  */
 void editorOpen(char *filename);
 
+/*
+ * Finish the background save if the save thread is done
+ */
+void editorPollSave();
+
+/*
+ * Wait for the background save to finish
+ */
+void editorWaitForSave();
+
+/*
+ * Returns `true` while a background save is running
+ */
+bool editorSaving();
+
 /*
  * Save the editor content to the opened file.
  * If no filename is set, prompt the user for one.
+ * The rows are written by a background thread, so the user can keep editing while the file is saved.
  */
 void editorSave();
 
@@ -0,0 +1,161 @@
+#include "editor.h"
+#include "highlight.h"
+#include "keywords.h"
+#include "languages.h"
+#include <stdlib.h>
+#include <string.h>
+
+extern struct editorConfig E;
+
+/*** keywords ***/
+
+/*
+ * Hash the `length` characters at `word` (FNV-1a followed by a final mix), `seed` selects one of many hash functions
+ */
+uint32_t editorKeywordHash(const char *word, uint32_t length, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+
+    for (uint32_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)word[i];
+        hash *= 16777619u;
+    }
+
+    hash ^= hash >> 15;
+    hash *= 0x2c1b3c6du;
+    hash ^= hash >> 12;
+
+    return hash;
+}
+
+/*
+ * Add the keywords of `array` not yet in `words` to `words`, returns the new number of words
+ */
+int editorCollectKeywords(char **array, int highlight, const char **words, unsigned char *highlights, int count) {
+    for (int i = 0; array[i] != NULL; i++) {
+        bool duplicate = false;
+
+        for (int j = 0; j < count; j++) {
+            if (!strcmp(words[j], array[i])) {
+                duplicate = true;
+                break;
+            }
+        }
+
+        if (!duplicate) {
+            words[count] = array[i];
+            highlights[count] = highlight;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*
+ * Returns `true` if the `count` words all hash to different slots of a table of `size` slots with `seed`
+ */
+bool editorKeywordSeedWorks(const char **words, int count, uint32_t size, uint32_t seed, bool *used) {
+    memset(used, 0, sizeof(bool) * size);
+
+    for (int i = 0; i < count; i++) {
+        uint32_t slot = editorKeywordHash(words[i], strlen(words[i]), seed) & (size - 1);
+
+        if (used[slot]) {
+            return false;
+        }
+
+        used[slot] = true;
+    }
+
+    return true;
+}
+
+/*
+ * Build the keyword table of the current language from its keyword lists, once per language.
+ * Words in both lists are highlighted as keyword2.
+ */
+void editorInitKeywordTable() {
+    if (E.syntax->keywords != NULL) {
+        return;
+    }
+
+    int total = 0;
+    while (E.syntax->keyword1[total] != NULL) {
+        total++;
+    }
+    for (int i = 0; E.syntax->keyword2[i] != NULL; i++) {
+        total++;
+    }
+
+    const char **words = malloc(sizeof(char *) * (total ? total : 1));
+    unsigned char *highlights = malloc(total ? total : 1);
+
+    // Keyword2 is checked first, so it wins for words in both lists
+    int count = editorCollectKeywords(E.syntax->keyword2, HL_KEYWORD2, words, highlights, 0);
+    count = editorCollectKeywords(E.syntax->keyword1, HL_KEYWORD1, words, highlights, count);
+
+    // Search a seed without collisions, doubling the table when none of the tried seeds works
+    uint32_t size = 1;
+    while (size < (uint32_t)count * 2) {
+        size *= 2;
+    }
+
+    bool *used = malloc(sizeof(bool) * size);
+    uint32_t seed = 0;
+
+    while (!editorKeywordSeedWorks(words, count, size, seed, used)) {
+        if (++seed == KEYWORD_SEED_TRIES) {
+            seed = 0;
+            size *= 2;
+            used = realloc(used, sizeof(bool) * size);
+        }
+    }
+
+    free(used);
+
+    struct editorKeywordTable *table = malloc(sizeof(struct editorKeywordTable));
+    table->size = size;
+    table->seed = seed;
+    table->max_length = 0;
+    table->words = calloc(size, sizeof(char *));
+    table->lengths = calloc(size, 1);
+    table->highlights = calloc(size, 1);
+
+    for (int i = 0; i < count; i++) {
+        uint32_t length = strlen(words[i]);
+        uint32_t slot = editorKeywordHash(words[i], length, seed) & (size - 1);
+
+        table->words[slot] = words[i];
+        table->lengths[slot] = length;
+        table->highlights[slot] = highlights[i];
+
+        if (length > table->max_length) {
+            table->max_length = length;
+        }
+    }
+
+    free(words);
+    free(highlights);
+
+    E.syntax->keywords = table;
+}
+
+/*
+ * Return the `editorHighlight` of the `length` characters at `word` if they are a keyword of the current language, -1 otherwise.
+ * `word` does not need to be NUL terminated, e.g. an identifier in a row.
+ */
+int editorKeywordHighlight(const char *word, uint32_t length) {
+    struct editorKeywordTable *table = E.syntax->keywords;
+
+    if (table == NULL || length == 0 || length > table->max_length) {
+        return -1;
+    }
+
+    uint32_t slot = editorKeywordHash(word, length, table->seed) & (table->size - 1);
+
+    if (table->words[slot] == NULL || table->lengths[slot] != length || memcmp(table->words[slot], word, length)) {
+        return -1;
+    }
+
+    return table->highlights[slot];
+}
@@ -0,0 +1,41 @@
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+#include <stdint.h>
+
+/*
+ * Number of seeds tried for a table size before the table is doubled
+ */
+#define KEYWORD_SEED_TRIES 4096
+
+/*
+ * Perfect hash table of the keywords of a language.
+ * The seed of the hash is chosen so every keyword has a slot of its own,
+ * so looking up a word is a single hash and at most one comparison.
+ */
+struct editorKeywordTable {
+    // Number of slots, a power of two
+    uint32_t size;
+    uint32_t seed;
+    // Length of the longest keyword, longer words are not hashed at all
+    uint32_t max_length;
+
+    // Keyword, its length and its `editorHighlight` in each slot, NULL for empty slots
+    const char **words;
+    unsigned char *lengths;
+    unsigned char *highlights;
+};
+
+/*
+ * Build the keyword table of the current language from its keyword lists, once per language.
+ * Words in both lists are highlighted as keyword2.
+ */
+void editorInitKeywordTable();
+
+/*
+ * Return the `editorHighlight` of the `length` characters at `word` if they are a keyword of the current language, -1 otherwise.
+ * `word` does not need to be NUL terminated, e.g. an identifier in a row.
+ */
+int editorKeywordHighlight(const char *word, uint32_t length);
+
+#endif
@@ -49,38 +49,50 @@ struct editorSyntax HLDB[] = {
     {
         "c",
         C_HL_extensions,
+        "c",
         C_HL_keyword1,
         C_HL_keyword2,
         C_HL_syntax1,
         C_HL_syntax2,
-        NULL, NULL, NULL
+        NULL, NULL,
+        NULL, 0, NULL,
+        NULL, NULL, NULL, NULL
     },
     {
         "Python",
         Python_HL_extensions,
+        "python",
         Python_HL_keyword1,
         Python_HL_keyword2,
         Python_HL_syntax1,
         Python_HL_syntax2,
-        NULL, NULL, NULL
+        NULL, NULL,
+        NULL, 0, NULL,
+        NULL, NULL, NULL, NULL
     },
     {
         "Rust",
         Rust_HL_extensions,
+        "rust",
         Rust_HL_keyword1,
         Rust_HL_keyword2,
         Rust_HL_syntax1,
         Rust_HL_syntax2,
-        NULL, NULL, NULL
+        NULL, NULL,
+        NULL, 0, NULL,
+        NULL, NULL, NULL, NULL
     },
     {
         "Haskell",
         Haskell_HL_extensions,
+        NULL,
         Haskell_HL_keyword1,
         Haskell_HL_keyword2,
         Haskell_HL_syntax1,
         Haskell_HL_syntax2,
-        NULL, NULL, NULL
+        NULL, NULL,
+        NULL, 0, NULL,
+        NULL, NULL, NULL, NULL
     }
 };
 
@@ -4,6 +4,18 @@
 #ifndef LANGUAGES_H
 #define LANGUAGES_H
 
+/*
+ * Highlighting of the syntax tree nodes of a symbol
+ */
+struct editorSymbolClass {
+    // `editorHighlight` of the nodes
+    unsigned char highlight;
+    // Language agnostic `editorSymbolHandler` refining the highlight
+    unsigned char handler;
+    // Language specific `editorSymbolHandler`, applied after `handler`
+    unsigned char language_handler;
+};
+
 /*
  * Struct for storing information for highlighting a particular filetype
  */
@@ -11,6 +23,8 @@ struct editorSyntax {
     char *filetype;
     // Keywords in the filename to detect filetype
     char **filematch;
+    // Directory in QUERY_DIR with the tree-sitter queries of the filetype, NULL if there are none
+    char *queries;
 
     // // Keywords of the current filetype (two types: add | after a keyword to set type2)
     // char **keywords;
@@ -40,8 +54,19 @@ struct editorSyntax {
     TSTree *tree;
     // current tree-sitter language
     TSLanguage *language;
-    // tree-sitter parser for current language
-    TSParser *parser;
+    // highlighting of each symbol of the language, indexed by TSSymbol
+    struct editorSymbolClass *symbols;
+    uint32_t symbol_count;
+    // perfect hash table of keyword1 and keyword2, see editorKeywordHighlight
+    struct editorKeywordTable *keywords;
+
+    // compiled highlight query, NULL when highlighting with the symbol table
+    TSQuery *query;
+    TSQueryCursor *query_cursor;
+    // `editorHighlight` of each capture of the query, -1 for captures that are not highlighted
+    int *capture_highlights;
+    // predicates of each pattern of the query
+    struct editorPatternPredicates *predicates;
 };
 
 extern struct editorSyntax HLDB[];
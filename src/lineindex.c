@@ -0,0 +1,254 @@
+#include "editor.h"
+#include "highlight.h"
+#include "lineindex.h"
+#include "terminal.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern struct editorConfig E;
+
+/*
+ * State shared between the background indexer and the editor
+ */
+struct lineIndex {
+    pthread_t thread;
+    // Protects all fields below
+    pthread_mutex_t lock;
+    // Signalled when the indexer publishes new lines
+    pthread_cond_t published;
+
+    // Offsets of the ends of lines found by the indexer that are not rows yet
+    size_t *ends;
+    int count;
+    int capacity;
+
+    bool done;
+};
+
+struct lineIndex LI = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .published = PTHREAD_COND_INITIALIZER,
+};
+
+/*
+ * Lines taken from the indexer by the editor thread
+ */
+struct lineIndexPending {
+    // Set while the indexer thread has not been joined
+    bool indexing;
+    // Set when the indexer was done when the line ends were taken
+    bool done;
+
+    // Line ends that are not rows yet
+    size_t *ends;
+    int count;
+    int next;
+
+    // Offset of the start of the next line to turn into a row
+    size_t next_line;
+};
+
+struct lineIndexPending LP = { false, false, NULL, 0, 0, 0 };
+
+/*** line index ***/
+
+/*
+ * Add the line ends in `batch` to the lines waiting to be turned into rows, must hold the lock
+ */
+void lineIndexPublish(size_t *batch, int count) {
+    if (LI.count + count > LI.capacity) {
+        LI.capacity = (LI.count + count) * 2;
+        LI.ends = realloc(LI.ends, sizeof(size_t) * LI.capacity);
+    }
+
+    memcpy(&LI.ends[LI.count], batch, sizeof(size_t) * count);
+    LI.count += count;
+}
+
+/*
+ * Background thread: scan the memory mapped file for newlines block by block,
+ * publishing the line ends after each block.
+ * memchr is vectorized by the C library, so the scan runs at memory bandwidth.
+ */
+void *lineIndexWorker(void *arg) {
+    (void)arg;
+
+    int batch_capacity = 1024;
+    size_t *batch = malloc(sizeof(size_t) * batch_capacity);
+
+    size_t pos = 0;
+    while (pos < E.mapSize) {
+        size_t block_end = pos + LINE_INDEX_BLOCK_SIZE;
+        if (block_end > E.mapSize) {
+            block_end = E.mapSize;
+        }
+
+        int count = 0;
+        char *p = E.map + pos;
+        char *end = E.map + block_end;
+        char *newline;
+
+        while ((newline = memchr(p, '\n', end - p)) != NULL) {
+            if (count == batch_capacity) {
+                batch_capacity *= 2;
+                batch = realloc(batch, sizeof(size_t) * batch_capacity);
+            }
+
+            batch[count++] = newline - E.map;
+            p = newline + 1;
+        }
+
+        pos = block_end;
+
+        pthread_mutex_lock(&LI.lock);
+
+        lineIndexPublish(batch, count);
+
+        if (pos == E.mapSize) {
+            // The last line does not need to end with a newline
+            if (E.map[E.mapSize - 1] != '\n') {
+                size_t last = E.mapSize;
+                lineIndexPublish(&last, 1);
+            }
+
+            LI.done = true;
+        }
+
+        pthread_cond_broadcast(&LI.published);
+        pthread_mutex_unlock(&LI.lock);
+    }
+
+    free(batch);
+
+    return NULL;
+}
+
+/*
+ * Start finding the lines of the memory mapped file on a background thread
+ */
+void editorStartLineIndex() {
+    LI.count = 0;
+    LI.done = false;
+
+    LP.done = false;
+    LP.count = 0;
+    LP.next = 0;
+    LP.next_line = 0;
+
+    if (pthread_create(&LI.thread, NULL, lineIndexWorker, NULL) != 0) {
+        die("pthread_create");
+    }
+
+    LP.indexing = true;
+
+    // Have the first screen of rows ready for the first frame
+    editorWaitForRow(E.screenrows);
+}
+
+/*
+ * Turn at most `max_rows` indexed lines into rows.
+ * Takes the lines published by the indexer when all taken lines are rows.
+ */
+void lineIndexIngest(int max_rows) {
+    if (LP.next == LP.count && !LP.done) {
+        free(LP.ends);
+
+        // Take the published line ends, so the indexer can continue while the rows are inserted
+        pthread_mutex_lock(&LI.lock);
+        LP.ends = LI.ends;
+        LP.count = LI.count;
+        LP.done = LI.done;
+        LI.ends = NULL;
+        LI.count = 0;
+        LI.capacity = 0;
+        pthread_mutex_unlock(&LI.lock);
+
+        LP.next = 0;
+    }
+
+    // Unindexed lines always come after all rows, so the lines are appended
+    for (; LP.next < LP.count && max_rows > 0; LP.next++, max_rows--) {
+        size_t end = LP.ends[LP.next];
+        char *line = E.map + LP.next_line;
+
+        // Do not include carriage returns in line length
+        size_t linelen = end - LP.next_line;
+        while (linelen > 0 && line[linelen - 1] == '\r') {
+            linelen--;
+        }
+
+        editorInsertMappedRow(E.numrows, line, linelen);
+
+        LP.next_line = end + 1;
+    }
+
+    if (LP.done && LP.next == LP.count) {
+        pthread_join(LI.thread, NULL);
+
+        free(LP.ends);
+        LP.ends = NULL;
+        LP.count = 0;
+        LP.next = 0;
+        LP.indexing = false;
+
+        editorInitSyntaxTree();
+    }
+}
+
+/*
+ * Turn (a frame's worth of) the lines found by the background indexer into rows.
+ * Initializes the syntax tree once the whole file is indexed.
+ */
+void editorIngestIndexedLines() {
+    if (LP.indexing) {
+        lineIndexIngest(LINE_INDEX_FRAME_ROWS);
+    }
+}
+
+/*
+ * Returns `true` while the file is being indexed
+ */
+bool editorIndexing() {
+    return LP.indexing;
+}
+
+/*
+ * Return how much of the file has been turned into rows in percent, -1 when not indexing.
+ * Lines the indexer found but that are not rows yet don't count, they are only added LINE_INDEX_FRAME_ROWS per frame.
+ */
+int editorIndexProgress() {
+    if (!LP.indexing) {
+        return -1;
+    }
+
+    // Rows are appended in file order, the next line starts after the bytes of all rows
+    return LP.next_line * 100 / E.mapSize;
+}
+
+/*
+ * Wait until the row at line `at` exists or the whole file has been indexed
+ */
+void editorWaitForRow(int at) {
+    while (LP.indexing && E.numrows <= at) {
+        // Wait for the indexer when all lines taken from it are rows
+        if (LP.next == LP.count && !LP.done) {
+            pthread_mutex_lock(&LI.lock);
+            while (LI.count == 0 && !LI.done) {
+                pthread_cond_wait(&LI.published, &LI.lock);
+            }
+            pthread_mutex_unlock(&LI.lock);
+        }
+
+        long needed = (long)at - E.numrows + 1;
+        lineIndexIngest(needed > INT_MAX ? INT_MAX : needed);
+    }
+}
+
+/*
+ * Wait until the whole file has been indexed
+ */
+void editorFinishIndexing() {
+    editorWaitForRow(INT_MAX);
+}
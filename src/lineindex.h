@@ -0,0 +1,58 @@
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <stdbool.h>
+
+/*
+ * Memory mapped files of at least this many bytes are indexed on a background thread
+ */
+#define LINE_INDEX_BACKGROUND_SIZE (1 << 22)
+
+/*
+ * Number of bytes the background indexer scans before publishing the lines it found
+ */
+#define LINE_INDEX_BLOCK_SIZE (1 << 20)
+
+/*
+ * Maximum number of indexed lines turned into rows per frame, keeps the editor responsive while indexing
+ */
+#define LINE_INDEX_FRAME_ROWS (1 << 17)
+
+/*
+ * Input timeout (in milliseconds) while indexing, so new rows are drawn without waiting for a key
+ */
+#define LINE_INDEX_INPUT_TIMEOUT 10
+
+/*
+ * Start finding the lines of the memory mapped file on a background thread
+ */
+void editorStartLineIndex();
+
+/*
+ * Turn (a frame's worth of) the lines found by the background indexer into rows.
+ * Initializes the syntax tree once the whole file is indexed.
+ */
+void editorIngestIndexedLines();
+
+/*
+ * Returns `true` while the file is being indexed
+ */
+bool editorIndexing();
+
+/*
+ * Return how much of the file has been turned into rows in percent, -1 when not indexing.
+ * Lines the indexer found but that are not rows yet don't count, they are only added LINE_INDEX_FRAME_ROWS per frame.
+ */
+int editorIndexProgress();
+
+/*
+ * Wait until the row at line `at` exists or the whole file has been indexed
+ */
+void editorWaitForRow(int at);
+
+/*
+ * Wait until the whole file has been indexed
+ */
+void editorFinishIndexing();
+
+#endif
@@ -16,23 +16,34 @@ int main(int argc, char *argv[]) {
     noecho();
     // enable capturing of keypresses
     keypad(stdscr, TRUE);
+    // Return ESC pressed alone after as long as the rest of an escape sequence is waited for, not after a second
+    set_escdelay(ESCAPE_SEQUENCE_TIMEOUT);
     // Remove delay between mouse events
     mouseinterval(0);
     mmask_t old;
     // make mouse events visible,  store old mask in `old`
     mousemask(ALL_MOUSE_EVENTS | REPORT_MOUSE_POSITION, &old);
+    // Have the terminal mark pasted text, so it is inserted at once instead of key by key
+    enableBracketedPaste();
 
     initEditor();
+
+    // Set before opening the file, so problems found while opening it are shown instead
+    editorSetStatusMessage("HELP: Ctrl-s = save, Ctrl-d = quit, Ctrl-f = search");
+
     if (argc >= 2) {
         editorOpen(argv[1]);
     }
 
-    editorSetStatusMessage("HELP: Ctrl-s = save, Ctrl-d = quit, Ctrl-f = search");
-
     while (true) {
         refresh();
         editorRefreshScreen();
         editorProcessKeypress();
+
+        // Handle all keys that are already there before drawing, so e.g. pasted text is reparsed once
+        while (editorKeyPending()) {
+            editorProcessKeypress();
+        }
     }
 
     endwin();
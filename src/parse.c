@@ -0,0 +1,423 @@
+#include "editor.h"
+#include "highlight.h"
+#include "languages.h"
+#include "parse.h"
+#include "terminal.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+extern struct editorConfig E;
+
+/*
+ * Parse requested by the editor thread
+ */
+struct editorParseJob {
+    const TSLanguage *language;
+    // Copy of the syntax tree with all edits up to the snapshot applied, NULL for the first parse
+    TSTree *old_tree;
+    // Rows when the parse was requested, the row tree copies what is modified while the snapshot is read
+    rowSnapshot text;
+    // Number of edits made before the snapshot
+    unsigned long generation;
+    // Next finished job
+    struct editorParseJob *next;
+};
+
+/*
+ * State shared between the parse thread and the editor
+ */
+struct editorParseState {
+    pthread_t thread;
+    // Set once the parse thread is started (only used by the editor thread)
+    bool started;
+
+    // Protects all fields below
+    pthread_mutex_t lock;
+    // Signalled when a parse is requested
+    pthread_cond_t requested;
+    // Signalled when a tree is published
+    pthread_cond_t published;
+
+    // Newest parse that was not started yet, replaced by newer requests
+    struct editorParseJob *pending;
+    // Set while the parse thread parses a job
+    bool parsing;
+    // Checked by tree-sitter while parsing, set when a newer parse makes the running one useless
+    size_t cancel;
+    // Time the last tree was published, or the first parse was requested
+    struct timespec published_at;
+
+    // Newest tree that was not taken by the editor yet, and the generation of its job
+    TSTree *result;
+    unsigned long result_generation;
+
+    // Jobs that are done, their snapshots are released by the editor thread
+    struct editorParseJob *finished;
+};
+
+struct editorParseState P = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .requested = PTHREAD_COND_INITIALIZER,
+    .published = PTHREAD_COND_INITIALIZER,
+};
+
+/*
+ * Edits the parse thread has not seen yet (only used by the editor thread)
+ */
+struct editorParseEdits {
+    TSInputEdit *edits;
+    int count;
+    int capacity;
+    // Generation of the first edit in `edits`
+    unsigned long first;
+    // Number of edits made since the first parse was requested
+    unsigned long generation;
+    // Set when edits were made since the last parse request
+    bool unparsed;
+};
+
+struct editorParseEdits PE = { NULL, 0, 0, 1, 0, false };
+
+/*** text snapshot ***/
+
+/*
+ * Position of the parse thread in a snapshot of the rows
+ */
+struct editorSnapshotReader {
+    const rowSnapshot *text;
+    // Leaf of the current row, NULL before the first read
+    rowLeaf *leaf;
+    int slot;
+    long row_start;
+};
+
+/*
+ * tree-sitter read callback of the parse thread, serves the text at `byte_index` from the snapshot.
+ * Returns the rest of the row, or the newline after it, without copying the text.
+ */
+const char *editorReadSnapshot(void *payload, uint32_t byte_index, TSPoint position, uint32_t *bytes_read) {
+    (void)position;
+    struct editorSnapshotReader *reader = payload;
+
+    if (byte_index >= reader->text->bytes) {
+        *bytes_read = 0;
+        return "";
+    }
+
+    rowLeaf *leaf = reader->leaf;
+
+    // Move to the next row of the leaf when the read continues past the current one, otherwise look the row up.
+    // The links between leaves are not part of the snapshot, the next leaf is found from the root.
+    if (leaf != NULL && byte_index > reader->row_start + leaf->size[reader->slot] && reader->slot + 1 < leaf->count) {
+        reader->row_start += leaf->size[reader->slot] + 1;
+        reader->slot++;
+    }
+
+    if (leaf == NULL || byte_index < reader->row_start || byte_index > reader->row_start + leaf->size[reader->slot]) {
+        leaf = rowSnapshotLeafAtByte(reader->text, byte_index, &reader->row_start);
+        reader->leaf = leaf;
+        reader->slot = 0;
+
+        while (byte_index > reader->row_start + leaf->size[reader->slot]) {
+            reader->row_start += leaf->size[reader->slot] + 1;
+            reader->slot++;
+        }
+    }
+
+    uint32_t column = byte_index - reader->row_start;
+
+    // Every row is followed by a newline
+    if (column == (uint32_t)leaf->size[reader->slot]) {
+        *bytes_read = 1;
+        return "\n";
+    }
+
+    *bytes_read = leaf->size[reader->slot] - column;
+    return &leaf->chars[reader->slot][column];
+}
+
+/*** parse thread ***/
+
+/*
+ * Release the snapshot and the old tree of `job` (only called by the editor thread)
+ */
+void editorFreeParseJob(struct editorParseJob *job) {
+    if (job->old_tree != NULL) {
+        ts_tree_delete(job->old_tree);
+    }
+
+    rowTreeReleaseSnapshot(&E.rows, &job->text);
+    free(job);
+}
+
+/*
+ * Background thread: parse the newest requested snapshot and publish the tree.
+ * The thread owns the parser, a parse is cancelled when a newer one is requested.
+ */
+void *editorParseWorker(void *arg) {
+    (void)arg;
+
+    TSParser *parser = ts_parser_new();
+    ts_parser_set_cancellation_flag(parser, &P.cancel);
+
+    while (true) {
+        pthread_mutex_lock(&P.lock);
+
+        while (P.pending == NULL) {
+            pthread_cond_wait(&P.requested, &P.lock);
+        }
+
+        struct editorParseJob *job = P.pending;
+        P.pending = NULL;
+        P.parsing = true;
+        __atomic_store_n(&P.cancel, 0, __ATOMIC_RELAXED);
+
+        pthread_mutex_unlock(&P.lock);
+
+        if (ts_parser_language(parser) != job->language) {
+            ts_parser_set_language(parser, job->language);
+        }
+
+        struct editorSnapshotReader reader = { &job->text, NULL, 0, 0 };
+
+        TSInput input = {
+            .payload = &reader,
+            .read = editorReadSnapshot,
+            .encoding = TSInputEncodingUTF8,
+        };
+
+        TSTree *tree = ts_parser_parse(parser, job->old_tree, input);
+
+        // A cancelled parse returns NULL, the next parse starts over
+        if (tree == NULL) {
+            ts_parser_reset(parser);
+        }
+
+        pthread_mutex_lock(&P.lock);
+
+        if (tree != NULL) {
+            if (P.result != NULL) {
+                ts_tree_delete(P.result);
+            }
+
+            P.result = tree;
+            P.result_generation = job->generation;
+            clock_gettime(CLOCK_MONOTONIC, &P.published_at);
+            pthread_cond_broadcast(&P.published);
+        }
+
+        P.parsing = false;
+
+        // The row tree is only modified by the editor thread, which releases the snapshot
+        job->next = P.finished;
+        P.finished = job;
+
+        pthread_mutex_unlock(&P.lock);
+    }
+
+    return NULL;
+}
+
+/*
+ * Snapshot the rows and have the parse thread parse them, replacing any parse that has not started yet.
+ * The running parse is cancelled, unless the last tree was published more than PARSE_CANCEL_WINDOW ago.
+ */
+void editorRequestParse() {
+    if (!P.started) {
+        clock_gettime(CLOCK_MONOTONIC, &P.published_at);
+
+        if (pthread_create(&P.thread, NULL, editorParseWorker, NULL) != 0) {
+            die("pthread_create");
+        }
+
+        P.started = true;
+    }
+
+    // A parse that was not started yet is replaced
+    pthread_mutex_lock(&P.lock);
+    struct editorParseJob *job = P.pending;
+    P.pending = NULL;
+    pthread_mutex_unlock(&P.lock);
+
+    if (job != NULL) {
+        editorFreeParseJob(job);
+    }
+
+    job = malloc(sizeof(struct editorParseJob));
+    job->language = E.syntax->language;
+    job->old_tree = E.syntax->tree != NULL ? ts_tree_copy(E.syntax->tree) : NULL;
+    job->generation = PE.generation;
+    job->next = NULL;
+    PE.unparsed = false;
+
+    // O(1), the rows modified from now on are copied
+    rowTreeSnapshot(&E.rows, &job->text);
+
+    pthread_mutex_lock(&P.lock);
+
+    P.pending = job;
+
+    // The running parse would be outdated when it is done. While the user keeps typing it is still finished
+    // now and then, otherwise files that take longer to parse than the pause between keys never get a new tree.
+    if (P.parsing) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        long age = (now.tv_sec - P.published_at.tv_sec) * 1000 + (now.tv_nsec - P.published_at.tv_nsec) / 1000000;
+        if (age < PARSE_CANCEL_WINDOW) {
+            __atomic_store_n(&P.cancel, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    pthread_cond_signal(&P.requested);
+    pthread_mutex_unlock(&P.lock);
+}
+
+/*
+ * Apply `edit` to the syntax tree, so it keeps matching the rows, and mark the rows for a reparse.
+ * Edits made before the first parse was requested are not recorded, the first parse reads all rows.
+ */
+void editorEditSyntaxTree(const TSInputEdit *edit) {
+    if (!P.started) {
+        return;
+    }
+
+    // Edit the syntax tree to keep in in sync with the edited sourcecode
+    // (see https://tree-sitter.github.io/tree-sitter/using-parsers#editing)
+    if (E.syntax->tree != NULL) {
+        ts_tree_edit(E.syntax->tree, edit);
+    }
+
+    // Keep the edit for trees parsed from older snapshots
+    if (PE.count == PE.capacity) {
+        PE.capacity = PE.capacity ? PE.capacity * 2 : 64;
+        PE.edits = realloc(PE.edits, sizeof(TSInputEdit) * PE.capacity);
+    }
+
+    PE.edits[PE.count++] = *edit;
+    PE.generation++;
+    PE.unparsed = true;
+}
+
+/*
+ * Request a single reparse for all edits made since the last frame
+ */
+void editorParseEdits() {
+    if (PE.unparsed) {
+        editorRequestParse();
+    }
+}
+
+/*
+ * Replace the syntax tree with `tree`, parsed from the snapshot taken after `generation` edits
+ */
+void editorPublishTree(TSTree *tree, unsigned long generation) {
+    // Apply the edits made while the tree was parsed, the next tree corrects their highlighting
+    int skipped = generation >= PE.first ? generation - PE.first + 1 : 0;
+
+    for (int i = skipped; i < PE.count; i++) {
+        ts_tree_edit(tree, &PE.edits[i]);
+    }
+
+    memmove(PE.edits, &PE.edits[skipped], sizeof(TSInputEdit) * (PE.count - skipped));
+    PE.count -= skipped;
+    PE.first += skipped;
+
+    if (E.syntax->tree == NULL) {
+        // The rows drawn before the first tree are not highlighted yet
+        editorInvalidateHighlight(0, E.numrows - 1);
+    } else {
+        uint32_t range_count;
+        TSRange *ranges = ts_tree_get_changed_ranges(E.syntax->tree, tree, &range_count);
+
+        for (uint32_t i = 0; i < range_count; i++) {
+            editorInvalidateHighlight(ranges[i].start_point.row, ranges[i].end_point.row);
+        }
+
+        free(ranges);
+
+        ts_tree_delete(E.syntax->tree);
+    }
+
+    E.syntax->tree = tree;
+}
+
+/*
+ * Take the newest tree published by the parse thread, if any.
+ * The rows whose syntax changed are highlighted again when they are drawn.
+ */
+void editorPollParse() {
+    if (!P.started) {
+        return;
+    }
+
+    pthread_mutex_lock(&P.lock);
+    TSTree *tree = P.result;
+    unsigned long generation = P.result_generation;
+    P.result = NULL;
+    struct editorParseJob *finished = P.finished;
+    P.finished = NULL;
+    pthread_mutex_unlock(&P.lock);
+
+    if (tree != NULL) {
+        editorPublishTree(tree, generation);
+    }
+
+    // Nodes and characters of rows changed while they were parsed can be freed once the parse is done
+    while (finished != NULL) {
+        struct editorParseJob *next = finished->next;
+        editorFreeParseJob(finished);
+        finished = next;
+    }
+
+    editorFreeDeferred();
+}
+
+/*
+ * Wait at most `milliseconds` for the parse thread to publish a tree, then take it
+ */
+void editorWaitForParse(int milliseconds) {
+    if (!P.started) {
+        return;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += milliseconds / 1000;
+    deadline.tv_nsec += (long)(milliseconds % 1000) * 1000000;
+
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&P.lock);
+
+    while (P.result == NULL && (P.pending != NULL || P.parsing)) {
+        if (pthread_cond_timedwait(&P.published, &P.lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&P.lock);
+
+    editorPollParse();
+}
+
+/*
+ * Returns `true` while the parse thread reads a snapshot of the rows or has a tree or a snapshot that was not taken yet
+ */
+bool editorParsing() {
+    if (!P.started) {
+        return false;
+    }
+
+    pthread_mutex_lock(&P.lock);
+    bool parsing = P.pending != NULL || P.parsing || P.result != NULL || P.finished != NULL;
+    pthread_mutex_unlock(&P.lock);
+
+    return parsing;
+}
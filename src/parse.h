@@ -0,0 +1,57 @@
+#ifndef PARSE_H
+#define PARSE_H
+
+#include <stdbool.h>
+#include <tree_sitter/api.h>
+
+/*
+ * Input timeout (in milliseconds) while parsing in the background, so the new tree is drawn without waiting for a key
+ */
+#define PARSE_INPUT_TIMEOUT 10
+
+/*
+ * Time (in milliseconds) the first frame waits for the first parse of a file,
+ * so files that parse quickly are not drawn without highlighting first
+ */
+#define PARSE_FIRST_WAIT 100
+
+/*
+ * Time (in milliseconds) since the last tree was published during which a new parse request cancels the running parse.
+ * Later requests let the running parse finish, so a fresh tree is drawn now and then while the user keeps typing.
+ */
+#define PARSE_CANCEL_WINDOW 250
+
+/*
+ * Apply `edit` to the syntax tree, so it keeps matching the rows, and mark the rows for a reparse.
+ * Edits made before the first parse was requested are not recorded, the first parse reads all rows.
+ */
+void editorEditSyntaxTree(const TSInputEdit *edit);
+
+/*
+ * Request a single reparse for all edits made since the last frame
+ */
+void editorParseEdits();
+
+/*
+ * Snapshot the rows and have the parse thread parse them, replacing any parse that has not started yet.
+ * The running parse is cancelled, unless the last tree was published more than PARSE_CANCEL_WINDOW ago.
+ */
+void editorRequestParse();
+
+/*
+ * Take the newest tree published by the parse thread, if any.
+ * The rows whose syntax changed are highlighted again when they are drawn.
+ */
+void editorPollParse();
+
+/*
+ * Wait at most `milliseconds` for the parse thread to publish a tree, then take it
+ */
+void editorWaitForParse(int milliseconds);
+
+/*
+ * Returns `true` while the parse thread reads a snapshot of the rows or has a tree or a snapshot that was not taken yet
+ */
+bool editorParsing();
+
+#endif
@@ -37,6 +37,11 @@ char *editorPrompt(char *prompt, int inputPos, void (*callback)(char *, int)) {
 
         int c = editorReadKey();
 
+        // Redraw on input timeout
+        if (c == NO_KEY) {
+            continue;
+        }
+
         // Return NULL if the user presses escape
         if (c == '\x1b') {
             // Reset cursor position
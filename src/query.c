@@ -0,0 +1,373 @@
+#include "editor.h"
+#include "highlight.h"
+#include "languages.h"
+#include "query.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern struct editorConfig E;
+
+/*
+ * Highlight of the captures with a given name
+ */
+struct editorCaptureName {
+    char *name;
+    int highlight;
+};
+
+/*
+ * Capture names usable in highlight queries.
+ * Names not in the list fall back to their prefix, e.g. "punctuation.bracket" is highlighted as "punctuation".
+ */
+struct editorCaptureName captureNames[] = {
+    { "none", HL_NORMAL },
+    { "comment", HL_COMMENT },
+    { "keyword", HL_KEYWORD1 },
+    { "keyword.directive", HL_KEYWORD2 },
+    { "type", HL_KEYWORD2 },
+    { "attribute", HL_KEYWORD2 },
+    { "constant", HL_CONSTANT },
+    { "constant.builtin", HL_KEYWORD2 },
+    { "number", HL_NUMBER },
+    { "string", HL_STRING },
+    { "string.escape", HL_SYNTAX1 },
+    { "function", HL_FUNCTION },
+    { "function.macro", HL_KEYWORD2 },
+    { "module", HL_FUNCTION },
+    { "property", HL_FIELD },
+    { "parameter", HL_KEYWORD1 },
+    { "label", HL_SYNTAX1 },
+    { "punctuation", HL_SYNTAX1 },
+    { "operator", HL_SYNTAX2 },
+    { NULL, 0 },
+};
+
+/*** highlight queries ***/
+
+/*
+ * Return the `editorHighlight` of capture `name` of length `length`, -1 for captures that are not highlighted.
+ * Captures starting with '_' are only used by predicates.
+ */
+int editorCaptureHighlight(const char *name, uint32_t length) {
+    if (length == 0 || name[0] == '_') {
+        return -1;
+    }
+
+    while (true) {
+        for (int i = 0; captureNames[i].name != NULL; i++) {
+            if (strlen(captureNames[i].name) == length && !strncmp(captureNames[i].name, name, length)) {
+                return captureNames[i].highlight;
+            }
+        }
+
+        // Fall back to the name without its last component
+        while (length > 0 && name[length - 1] != '.') {
+            length--;
+        }
+
+        if (length == 0) {
+            return -1;
+        }
+
+        length--;
+    }
+}
+
+/*
+ * Compile the predicates of every pattern of `query`.
+ * Predicates other than #eq?, #not-eq?, #match?, #not-match? and #name? comparing a capture with a string are ignored.
+ * #name? matches one of the `editorNamePattern`s without a regular expression, e.g. `(#name? @constant "constant")`.
+ */
+struct editorPatternPredicates *editorCompilePredicates(TSQuery *query) {
+    uint32_t pattern_count = ts_query_pattern_count(query);
+    struct editorPatternPredicates *patterns = calloc(pattern_count, sizeof(struct editorPatternPredicates));
+
+    for (uint32_t pattern = 0; pattern < pattern_count; pattern++) {
+        uint32_t step_count;
+        const TSQueryPredicateStep *steps = ts_query_predicates_for_pattern(query, pattern, &step_count);
+
+        uint32_t start = 0;
+        for (uint32_t i = 0; i < step_count; i++) {
+            if (steps[i].type != TSQueryPredicateStepTypeDone) {
+                continue;
+            }
+
+            // Predicates are a name followed by the arguments, ended by a done step
+            const TSQueryPredicateStep *predicate = &steps[start];
+            uint32_t argument_count = i - start;
+            start = i + 1;
+
+            if (argument_count != 3 ||
+                predicate[0].type != TSQueryPredicateStepTypeString ||
+                predicate[1].type != TSQueryPredicateStepTypeCapture ||
+                predicate[2].type != TSQueryPredicateStepTypeString) {
+                continue;
+            }
+
+            uint32_t length;
+            const char *name = ts_query_string_value_for_id(query, predicate[0].value_id, &length);
+
+            struct editorQueryPredicate compiled;
+            compiled.capture = predicate[1].value_id;
+            compiled.text = ts_query_string_value_for_id(query, predicate[2].value_id, &compiled.length);
+
+            if (!strcmp(name, "eq?")) {
+                compiled.type = PREDICATE_EQ;
+            } else if (!strcmp(name, "not-eq?")) {
+                compiled.type = PREDICATE_NOT_EQ;
+            } else if (!strcmp(name, "match?") || !strcmp(name, "not-match?")) {
+                compiled.type = !strcmp(name, "match?") ? PREDICATE_MATCH : PREDICATE_NOT_MATCH;
+
+                if (regcomp(&compiled.regex, compiled.text, REG_EXTENDED | REG_NOSUB)) {
+                    continue;
+                }
+            } else if (!strcmp(name, "name?")) {
+                compiled.type = PREDICATE_NAME;
+                compiled.pattern = editorNamePatternFor(compiled.text);
+
+                if (compiled.pattern == -1) {
+                    continue;
+                }
+            } else {
+                continue;
+            }
+
+            struct editorPatternPredicates *current = &patterns[pattern];
+            current->predicates = realloc(current->predicates, sizeof(struct editorQueryPredicate) * (current->count + 1));
+            current->predicates[current->count++] = compiled;
+        }
+    }
+
+    return patterns;
+}
+
+/*
+ * Read the whole query file at `path` and store its length in `length`.
+ * Returns NULL with `errno` set if the file can't be read.
+ */
+char *editorReadQueryFile(const char *path, size_t *length) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    *length = 0;
+    size_t capacity = 4096;
+    char *source = malloc(capacity);
+    size_t read;
+
+    while ((read = fread(source + *length, 1, capacity - *length, file)) > 0) {
+        *length += read;
+
+        if (*length == capacity) {
+            capacity *= 2;
+            source = realloc(source, capacity);
+        }
+    }
+
+    fclose(file);
+
+    return source;
+}
+
+/*
+ * Compile the highlight query of the current language, once per language.
+ * The query is compiled into the editor, so it does not depend on where the editor is run from,
+ * unless QUERY_DIR_ENV names a directory to read it from.
+ * Returns `false` when the language has no valid highlight query, it is then highlighted with the symbol table.
+ */
+bool editorLoadHighlightQuery() {
+    if (E.syntax->query != NULL) {
+        return true;
+    }
+
+    if (E.syntax->queries == NULL) {
+        return false;
+    }
+
+    char name[PATH_MAX];
+    const char *source = NULL;
+    size_t length = 0;
+    char *file_source = NULL;
+
+    const char *dir = getenv(QUERY_DIR_ENV);
+    if (dir != NULL && dir[0] != '\0') {
+        snprintf(name, sizeof(name), "%s/%s/highlights.scm", dir, E.syntax->queries);
+
+        file_source = editorReadQueryFile(name, &length);
+        if (file_source == NULL) {
+            editorSetStatusMessage("Couldn't read highlight query %s: %s, using the built-in query", name, strerror(errno));
+        }
+
+        source = file_source;
+    }
+
+    if (source == NULL) {
+        snprintf(name, sizeof(name), "built-in %s highlight query", E.syntax->queries);
+
+        for (int i = 0; editorQuerySources[i].language != NULL; i++) {
+            if (!strcmp(editorQuerySources[i].language, E.syntax->queries)) {
+                source = (const char *)editorQuerySources[i].source;
+                length = editorQuerySources[i].length;
+                break;
+            }
+        }
+
+        if (source == NULL) {
+            editorSetStatusMessage("No %s highlight query was built in, highlighting without it", E.syntax->queries);
+            return false;
+        }
+    }
+
+    uint32_t error_offset;
+    TSQueryError error_type;
+    TSQuery *query = ts_query_new(E.syntax->language, source, length, &error_offset, &error_type);
+
+    free(file_source);
+
+    if (query == NULL) {
+        editorSetStatusMessage("Invalid highlight query %s (error %d at offset %u)", name, error_type, error_offset);
+        return false;
+    }
+
+    // Map the captures to highlights once, so highlighting a capture is an array lookup
+    uint32_t capture_count = ts_query_capture_count(query);
+    E.syntax->capture_highlights = malloc(sizeof(int) * (capture_count ? capture_count : 1));
+
+    for (uint32_t capture = 0; capture < capture_count; capture++) {
+        uint32_t name_length;
+        const char *name = ts_query_capture_name_for_id(query, capture, &name_length);
+
+        E.syntax->capture_highlights[capture] = editorCaptureHighlight(name, name_length);
+    }
+
+    E.syntax->predicates = editorCompilePredicates(query);
+    E.syntax->query = query;
+    E.syntax->query_cursor = ts_query_cursor_new();
+
+    return true;
+}
+
+/*
+ * Returns `true` if all predicates of the pattern of `match` hold.
+ * The captured text is read directly from the row, captures spanning multiple rows never match.
+ */
+bool editorPredicatesHold(const TSQueryMatch *match) {
+    struct editorPatternPredicates *patterns = &E.syntax->predicates[match->pattern_index];
+
+    for (int i = 0; i < patterns->count; i++) {
+        struct editorQueryPredicate *predicate = &patterns->predicates[i];
+
+        // Find the text of the tested capture
+        const char *text = NULL;
+        uint32_t length = 0;
+
+        for (uint16_t c = 0; c < match->capture_count; c++) {
+            if (match->captures[c].index != predicate->capture) {
+                continue;
+            }
+
+            TSPoint start = ts_node_start_point(match->captures[c].node);
+            TSPoint end = ts_node_end_point(match->captures[c].node);
+            erow row = editorRowAt(start.row);
+
+            if (start.row == end.row && ROW_EXISTS(row) && end.column <= (uint32_t)ROW_SIZE(row)) {
+                text = &ROW_CHARS(row)[start.column];
+                length = end.column - start.column;
+            }
+
+            break;
+        }
+
+        if (text == NULL) {
+            return false;
+        }
+
+        bool holds;
+        switch (predicate->type) {
+            case PREDICATE_EQ:
+            case PREDICATE_NOT_EQ:
+                holds = length == predicate->length && !memcmp(text, predicate->text, length);
+                holds = holds == (predicate->type == PREDICATE_EQ);
+                break;
+            case PREDICATE_NAME:
+                holds = editorMatchName(text, length, predicate->pattern);
+                break;
+            default: {
+                // Regular expressions need NUL terminated text, rows are not NUL terminated
+                char buffer[256];
+                if (length >= sizeof(buffer)) {
+                    return false;
+                }
+
+                memcpy(buffer, text, length);
+                buffer[length] = '\0';
+
+                holds = !regexec(&predicate->regex, buffer, 0, NULL, 0);
+                holds = holds == (predicate->type == PREDICATE_MATCH);
+                break;
+            }
+        }
+
+        if (!holds) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Highlight the rows from `start_row` up to and including `end_row` with the captures of the highlight query
+ * matching inside `node`. The query cursor only visits the nodes overlapping the rows.
+ * Captures are returned in order, so later (more specific) captures overwrite earlier ones.
+ */
+void editorHighlightQueryNode(TSNode node, int start_row, int end_row) {
+    TSQueryCursor *cursor = E.syntax->query_cursor;
+
+    ts_query_cursor_set_point_range(cursor, (TSPoint){ start_row, 0 }, (TSPoint){ end_row + 1, 0 });
+    ts_query_cursor_exec(cursor, E.syntax->query, node);
+
+    TSQueryMatch match;
+    uint32_t capture_index;
+
+    while (ts_query_cursor_next_capture(cursor, &match, &capture_index)) {
+        TSQueryCapture capture = match.captures[capture_index];
+        int highlight = E.syntax->capture_highlights[capture.index];
+
+        if (highlight == -1 || !editorPredicatesHold(&match)) {
+            continue;
+        }
+
+        TSPoint start = ts_node_start_point(capture.node);
+        TSPoint end = ts_node_end_point(capture.node);
+
+        editorApplyHighlight(start, end, highlight, start_row, end_row);
+    }
+}
+
+/*
+ * Highlight the rows from `start_row` up to and including `end_row` with the captures of the highlight query.
+ * The query cursor steps through every top-level node before the rows, which takes milliseconds in large files,
+ * so the query is run on each top-level node overlapping the rows instead.
+ */
+void editorHighlightQuery(int start_row, int end_row) {
+    TSTreeCursor tree_cursor = ts_tree_cursor_new(ts_tree_root_node(E.syntax->tree));
+
+    if (ts_tree_cursor_goto_first_child_for_point(&tree_cursor, (TSPoint){ start_row, 0 }) != -1) {
+        do {
+            TSNode node = ts_tree_cursor_current_node(&tree_cursor);
+
+            if (ts_node_start_point(node).row > (uint32_t)end_row) {
+                break;
+            }
+
+            editorHighlightQueryNode(node, start_row, end_row);
+        } while (ts_tree_cursor_goto_next_sibling(&tree_cursor));
+    }
+
+    ts_tree_cursor_delete(&tree_cursor);
+}
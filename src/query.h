@@ -0,0 +1,80 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <regex.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Environment variable naming a directory with a directory of tree-sitter queries per language.
+ * Its queries are read instead of the ones compiled into the editor, e.g. while working on the queries.
+ */
+#define QUERY_DIR_ENV "EDIT_QUERY_DIR"
+
+/*
+ * Highlight query of a language, compiled into the editor from queries/<language>/highlights.scm
+ */
+struct editorQuerySource {
+    const char *language;
+    const unsigned char *source;
+    unsigned int length;
+};
+
+/*
+ * Queries compiled into the editor, the last entry has no language (generated by the Makefile)
+ */
+extern const struct editorQuerySource editorQuerySources[];
+
+/*
+ * Query predicates tested on the text of a capture
+ */
+enum editorPredicateType {
+    PREDICATE_EQ,
+    PREDICATE_NOT_EQ,
+    PREDICATE_MATCH,
+    PREDICATE_NOT_MATCH,
+    PREDICATE_NAME,
+};
+
+/*
+ * Compiled predicate of a query pattern, e.g. `(#match? @constant "^[A-Z]+$")` or `(#name? @constant "constant")`
+ */
+struct editorQueryPredicate {
+    enum editorPredicateType type;
+    // Index of the tested capture
+    uint32_t capture;
+    // Text compared with for #eq?
+    const char *text;
+    uint32_t length;
+    // Regular expression for #match?
+    regex_t regex;
+    // `editorNamePattern` for #name?
+    int pattern;
+};
+
+/*
+ * Predicates of a query pattern, all have to hold for a match of the pattern
+ */
+struct editorPatternPredicates {
+    struct editorQueryPredicate *predicates;
+    int count;
+};
+
+/*
+ * Read the whole query file at `path` and store its length in `length`.
+ * Returns NULL with `errno` set if the file can't be read.
+ */
+char *editorReadQueryFile(const char *path, size_t *length);
+
+/*
+ * Compile the highlight query of the current language, once per language.
+ * Returns `false` when the language has no valid highlight query, it is then highlighted with the symbol table.
+ */
+bool editorLoadHighlightQuery();
+
+/*
+ * Highlight the rows from `start_row` up to and including `end_row` with the captures of the highlight query
+ */
+void editorHighlightQuery(int start_row, int end_row);
+
+#endif
@@ -1,21 +1,78 @@
+#include "arena.h"
 #include "editor.h"
 #include "highlight.h"
+#include "io.h"
 #include "languages.h"
+#include "lineindex.h"
 #include "main.h"
+#include "parse.h"
+#include "search.h"
 #include <ctype.h>
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 extern struct editorConfig E;
 
 /*
- * Convert cursor x (`cx`) to rendered x position based on the characters in `row`
+ * Lines of the last frame written to the terminal, only lines that changed are sent again
+ */
+struct editorFrame {
+    // Output of every screen line: the text rows, the status bar and the message bar
+    struct abuf *lines;
+    // Set when the terminal shows the stored output of the line
+    bool *valid;
+    int count;
+
+    // Row offset of the last frame
+    int row_offset;
+
+    // Output written to the terminal and the line being drawn, reused between frames
+    struct abuf out;
+    struct abuf line;
+
+    // Highlight drawn over the syntax highlight of the row being drawn (search matches), one per screen column
+    unsigned char *overlay;
+    int overlay_size;
+};
+
+struct editorFrame F = { NULL, NULL, 0, 0, ABUF_INIT, ABUF_INIT, NULL, 0 };
+
+/*
+ * SGR escape sequence selecting the colors of a highlight class (from any state)
  */
-int editorRowCxtoRx(erow *row, int cx) {
-    int rx = 0;
-    for (int i = 0; i < cx; i++) {
-        char c = row->chars[i];
+struct editorStyle {
+    char sgr[16];
+    int len;
+    // Classes with the same key look the same, no escape sequence is needed between them
+    int key;
+};
+
+struct editorStyle styles[HL_COUNT];
+bool stylesReady = false;
+
+/*
+ * Width of the line number column, only recomputed when the number of rows changes its number of digits
+ */
+struct editorGutter {
+    // Number of digits of the number of rows
+    int digits;
+    // Range of row counts with that number of digits
+    int min_rows;
+    int max_rows;
+};
+
+struct editorGutter G = { 1, 0, 9 };
+
+/*
+ * Convert cursor x `cx` to rendered x, continuing from the known rendered x `from_rx` of cursor x `from_cx` (<= `cx`)
+ */
+int editorRowCxtoRxFrom(erow row, int from_cx, int from_rx, int cx) {
+    int rx = from_rx;
+    for (int i = from_cx; i < cx; i++) {
+        char c = ROW_CHARS(row)[i];
 
         if (c == '\t') {
             rx += (TAB_SIZE - 1) - (rx % TAB_SIZE);
@@ -28,15 +85,22 @@ int editorRowCxtoRx(erow *row, int cx) {
     return rx;
 }
 
+/*
+ * Convert cursor x (`cx`) to rendered x position based on the characters in `row`
+ */
+int editorRowCxtoRx(erow row, int cx) {
+    return editorRowCxtoRxFrom(row, 0, 0, cx);
+}
+
 /*
  * Convert rendered x (`rx`) to cursor x position based on the characters in `row`
  */
-int editorRowRxtoCx(erow *row, int rx) {
+int editorRowRxtoCx(erow row, int rx) {
     int cur_rx = 0;
 
     int cx;
-    for (cx = 0; cx < row->size; cx++) {
-        char c = row->chars[cx];
+    for (cx = 0; cx < ROW_SIZE(row); cx++) {
+        char c = ROW_CHARS(row)[cx];
 
         if (c == '\t') {
             cur_rx += (TAB_SIZE - 1) - (cur_rx % TAB_SIZE);
@@ -62,7 +126,7 @@ int editorRowRxtoCx(erow *row, int rx) {
 void editorScroll() {
     E.rx = 0;
     if (E.cy < E.numrows) {
-        E.rx = editorRowCxtoRx(&E.row[E.cy], E.cx);
+        E.rx = editorRowCxtoRx(editorRowAt(E.cy), E.cx);
     }
 
     if (E.cy < E.row_offset) {
@@ -87,14 +151,17 @@ void editorScroll() {
  * Makes sure the highlighting still works on differently rendered characters.
  */
 void editorCalculateRenderedRows(int start_row, int end_row) {
+    rowIterator it;
+    rowTreeIterate(&E.rows, start_row, &it);
+
     for (int r = start_row; r <= end_row && r < E.numrows; r++) {
-        erow *row = &E.row[r];
+        erow row = rowIteratorNext(&it);
 
         // Count the tabs in the row
         int tabs = 0;
         int ctrl_chars = 0;
-        for (int i = 0; i < row->size; i++) {
-            char c = row->chars[i];
+        for (int i = 0; i < ROW_SIZE(row); i++) {
+            char c = ROW_CHARS(row)[i];
 
             if (c == '\t') {
                 tabs++;
@@ -104,178 +171,351 @@ void editorCalculateRenderedRows(int start_row, int end_row) {
             }
         }
 
-        // allocate extra space for our row with the tabs replaced by spaces
-        free(row->render);
-        int renderSize = row->size + tabs * (TAB_SIZE - 1) + ctrl_chars + 1;
-        row->render = malloc(renderSize);
+        // allocate extra space for our row with the tabs replaced by spaces,
+        // the old block is kept when it is large enough
+        int renderSize = ROW_SIZE(row) + tabs * (TAB_SIZE - 1) + ctrl_chars + 1;
+        ROW_RENDER(row) = arenaRealloc(ROW_RENDER(row), renderSize);
 
         unsigned char renderHighlight[renderSize];
 
         // Replace characters in row
         int index = 0;
-        for (int i = 0; i < row->size; i++) {
-            char c = row->chars[i];
-            unsigned char h = row->highlight[i];
+        for (int i = 0; i < ROW_SIZE(row); i++) {
+            char c = ROW_CHARS(row)[i];
+            // Rows without highlighting yet are rendered as normal text
+            unsigned char h = ROW_HIGHLIGHT(row) ? ROW_HIGHLIGHT(row)[i] : HL_NORMAL;
 
             // Render tabs as TAB_SIZE spaces
             if (c == '\t') {
                 do {
                     renderHighlight[index] = h;
-                    row->render[index++] = '>';
+                    ROW_RENDER(row)[index++] = '>';
                 } while (index % TAB_SIZE != 0);
             }
             // Render control characters with a preceding '^'
             else if (iscntrl(c)) {
                 renderHighlight[index] = h;
-                row->render[index++] = '^';
+                ROW_RENDER(row)[index++] = '^';
                 renderHighlight[index] = h;
-                row->render[index++] = c;
+                ROW_RENDER(row)[index++] = c;
             }
             else {
                 renderHighlight[index] = h;
-                row->render[index++] = c;
+                ROW_RENDER(row)[index++] = c;
             }
         }
 
-        row->render[index] = '\0';
-        row->renderSize = index;
+        ROW_RENDER(row)[index] = '\0';
+        ROW_RENDER_SIZE(row) = index;
 
-        row->highlight = realloc(row->highlight, renderSize);
-        memcpy(row->highlight, renderHighlight, renderSize);
+        ROW_HIGHLIGHT(row) = arenaRealloc(ROW_HIGHLIGHT(row), renderSize);
+        memcpy(ROW_HIGHLIGHT(row), renderHighlight, renderSize);
     }
 }
 
 /*
- * Add editor rows to append buffer `ab`.
- * empty lines are shown as "~".
+ * Update the width of the line number column when the number of rows has a different number of digits
  */
-void editorDrawRows(struct abuf *ab) {
-    for (int y = 0; y < E.screenrows; y++) {
-        int filerow = y + E.row_offset;
-
-        if (filerow >= E.numrows) {
-            if (E.numrows == 0 && y == E.screenrows / 3) {
-                // Draw welcome message
-                char welcome[80];
-                int welcomelen = snprintf(welcome, sizeof(welcome), "\x1b[4mLeon's editor -- version %s\x1b[m", VERSION);
-                if (welcomelen > E.screencols) {
-                    welcomelen = E.screencols;
-                }
+void editorUpdateGutter() {
+    if (E.numrows >= G.min_rows && E.numrows <= G.max_rows) {
+        return;
+    }
 
-                int padding = (E.screencols - welcomelen) / 2;
-                if (padding) {
-                    abAppend(ab, "~", 1);
-                    padding--;
-                }
+    G.digits = 1;
+    G.min_rows = 0;
+    G.max_rows = 9;
 
-                while (padding--) {
-                    abAppend(ab, " ", 1);
-                }
+    while (E.numrows > G.max_rows) {
+        G.digits++;
+        G.min_rows = G.max_rows + 1;
+        // The largest row count, INT_MAX, has 10 digits
+        G.max_rows = (G.digits == 10) ? INT_MAX : G.max_rows * 10 + 9;
+    }
+}
+
+/*
+ * Write `number` right aligned in `width` characters to `buf`, padded with spaces
+ */
+void editorFormatLineNumber(char *buf, int width, int number) {
+    int i = width;
+
+    do {
+        buf[--i] = '0' + number % 10;
+        number /= 10;
+    } while (number > 0 && i > 0);
+
+    while (i > 0) {
+        buf[--i] = ' ';
+    }
+}
 
-                abAppend(ab, welcome, welcomelen);
-            } else {
+/*
+ * Fill the table with the SGR escape sequence of every highlight class
+ */
+void editorInitStyles() {
+    for (int hl = 0; hl < HL_COUNT; hl++) {
+        struct editorStyle *style = &styles[hl];
+
+        if (hl == HL_NORMAL) {
+            style->len = snprintf(style->sgr, sizeof(style->sgr), "\x1b[m");
+        } else if (hl == HL_MATCH) {
+            // Search matches are blue and inverted
+            style->len = snprintf(style->sgr, sizeof(style->sgr), "\x1b[0;34;7m");
+        } else if (hl == HL_MATCH_SELECTED) {
+            // The selected search match is yellow and inverted
+            style->len = snprintf(style->sgr, sizeof(style->sgr), "\x1b[0;33;7m");
+        } else {
+            style->len = snprintf(style->sgr, sizeof(style->sgr), "\x1b[0;%dm", editorSyntaxToColor(hl));
+        }
+
+        style->key = hl;
+        for (int other = 0; other < hl; other++) {
+            if (strcmp(styles[other].sgr, style->sgr) == 0) {
+                style->key = styles[other].key;
+                break;
+            }
+        }
+    }
+
+    stylesReady = true;
+}
+
+/*
+ * Returns `true` if rendered character `i` of `c` (of length `len`) is drawn as a symbol:
+ * control characters, the '^' in front of them and non-ASCII characters
+ */
+bool editorIsSymbol(char *c, int i, int len) {
+    return iscntrl(c[i]) || (i + 1 < len && iscntrl(c[i + 1])) || c[i] < 0;
+}
+
+/*
+ * Return the highlight of render column `i`, the highlight in `overlay` (if any) is drawn over the syntax highlight
+ */
+int editorCellHighlight(const unsigned char *highlight, const unsigned char *overlay, int i) {
+    if (overlay != NULL && overlay[i] != HL_NORMAL) {
+        return overlay[i];
+    }
+
+    return highlight[i] < HL_COUNT ? highlight[i] : HL_NORMAL;
+}
+
+/*
+ * Add screen line `y` to append buffer `ab`, the row at `it` is drawn if `y` shows a row.
+ * empty lines are shown as "~".
+ */
+void editorDrawRow(struct abuf *ab, int y, rowIterator *it) {
+    int filerow = y + E.row_offset;
+
+    if (filerow >= E.numrows) {
+        if (E.numrows == 0 && y == E.screenrows / 3) {
+            // Draw welcome message
+            char welcome[80];
+            int welcomelen = snprintf(welcome, sizeof(welcome), "\x1b[4mLeon's editor -- version %s\x1b[m", VERSION);
+            if (welcomelen > E.screencols) {
+                welcomelen = E.screencols;
+            }
+
+            int padding = (E.screencols - welcomelen) / 2;
+            if (padding) {
                 abAppend(ab, "~", 1);
+                padding--;
             }
+
+            while (padding--) {
+                abAppend(ab, " ", 1);
+            }
+
+            abAppend(ab, welcome, welcomelen);
         } else {
-            // Draw line numbers
-            char max_line_nr[16];
-            snprintf(max_line_nr, sizeof(max_line_nr), "%d", E.numrows);
-            int max_line_nr_len = strlen(max_line_nr);
+            abAppend(ab, "~", 1);
+        }
+    } else {
+        // Draw line numbers, relative to the cursor row in relative mode (except on the cursor row)
+        int line_nr = filerow + 1;
+        if (E.relative_line_nrs && filerow != E.cy) {
+            line_nr = abs(filerow - E.cy);
+        }
 
-            char *spacing = " ";
-            char line_nr_col_width_format[16];
-            snprintf(line_nr_col_width_format, sizeof(line_nr_col_width_format), "%%%dd%s", max_line_nr_len, spacing);
+        char line_nr_col[16];
+        editorFormatLineNumber(line_nr_col, G.digits, line_nr);
+        line_nr_col[G.digits] = ' ';
+        E.line_nr_len = G.digits + 1;
 
-            char line_nr[16];
-            int line_number_len = snprintf(line_nr, sizeof(line_nr), line_nr_col_width_format, y + E.row_offset + 1);
-            E.line_nr_len = max_line_nr_len + strlen(spacing);
+        abAppend(ab, line_nr_col, E.line_nr_len);
 
-            abAppend(ab, line_nr, line_number_len);
+        erow row = rowIteratorNext(it);
 
-            int len = E.row[filerow].renderSize - E.col_offset;
-            if (len < 0) {
-                len = 0;
+        int len = ROW_RENDER_SIZE(row) - E.col_offset;
+        if (len < 0) {
+            len = 0;
+        }
+        if (len > E.screencols) {
+            len = E.screencols;
+        }
+
+        char *c = &ROW_RENDER(row)[E.col_offset];
+        unsigned char *highlight = &ROW_HIGHLIGHT(row)[E.col_offset];
+
+        // Search matches are drawn over the syntax highlight, rows without visible matches have no overlay
+        unsigned char *overlay = editorOverlayMatches(row, filerow, F.overlay, E.col_offset, len) ? F.overlay : NULL;
+
+        // Draw runs of characters with the same highlight at once, only changing colors between runs
+        struct editorStyle *current = &styles[HL_NORMAL];
+        int i = 0;
+        while (i < len) {
+            // Draw control characters and preceding '^' as well as non-ASCII characters as symbols
+            if (editorIsSymbol(c, i, len)) {
+                char symbol;
+                if (c[i] == '^') {
+                    symbol = '^';
+                } else if (c[i] < 0) {
+                    // draw non-ASCII characters as ?
+                    symbol = '?';
+                } else {
+                    symbol = (c[i] <= 26) ? '@' + c[i] : '?';
+                }
+                // Bright grey, inverted
+                abAppend(ab, "\x1b[90;7m", 8);
+                abAppend(ab, &symbol, 1);
+                // Restore the color of the current run
+                abAppend(ab, current->sgr, current->len);
+
+                i++;
+                continue;
             }
-            if (len > E.screencols) {
-                len = E.screencols;
+
+            int hl = editorCellHighlight(highlight, overlay, i);
+
+            int end = i + 1;
+            while (end < len && editorCellHighlight(highlight, overlay, end) == hl && !editorIsSymbol(c, end, len)) {
+                end++;
             }
 
-            char *c = &E.row[filerow].render[E.col_offset];
-            unsigned char *highlight = &E.row[filerow].highlight[E.col_offset];
-
-            int current_color = -1;
-            for (int i = 0; i < len; i++) {
-                // Set color of control characters and preceding '^' as well as non-ASCII characters
-                if (iscntrl(c[i]) || (i + 1 < len && iscntrl(c[i+1])) || c[i] < 0) {
-                    char symbol;
-                    if (c[i] == '^') {
-                        symbol = '^';
-                    } else if (c[i] < 0) {
-                        // draw non-ASCII characters as ?
-                        symbol = '?';
-                    } else {
-                        symbol = (c[i] <= 26) ? '@' + c[i] : '?';
-                    }
-                    // Set color to bright grey
-                    abAppend(ab, "\x1b[90m", 5);
-                    // Invert color
-                    abAppend(ab, "\x1b[7m", 4);
-                    abAppend(ab, &symbol, 1);
-                    // Reset color
-                    abAppend(ab, "\x1b[m", 3);
-                    if (current_color != -1) {
-                        char buf[16];
-                        int color_len = snprintf(buf, sizeof(buf), "\x1b[%dm", current_color);
-                        abAppend(ab, buf, color_len);
-                    }
-                }
-                // Set default text color
-                else if (highlight[i] == HL_NORMAL) {
-                    // Only insert 'reset' escape code when current color is not default
-                    if (current_color != -1) {
-                        abAppend(ab, "\x1b[39m", 5);
-                        abAppend(ab, "\x1b[m", 3);
-                        current_color = -1;
-                    }
-
-                    abAppend(ab, &c[i], 1);
-                }
-                // Set search result match color
-                else if (highlight[i] == HL_MATCH) {
-                    // Only insert invert escape code when current color is not inverted
-                    if (current_color != HL_MATCH) {
-                        current_color = HL_MATCH;
-                        abAppend(ab, "\x1b[34m", 5);
-                        abAppend(ab, "\x1b[7m", 4);
-                    }
-
-                    abAppend(ab, &c[i], 1);
-                }
-                // Set special text color
-                else {
-                    int color = editorSyntaxToColor(highlight[i]);
-
-                    // Only insert color escape code when current color is the current color
-                    if (color != current_color) {
-                        current_color = color;
-                        abAppend(ab, "\x1b[m", 3);
-                        char buf[16];
-                        int colorLength = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
-                        abAppend(ab, buf, colorLength);
-                    }
-
-                    abAppend(ab, &c[i], 1);
-                }
+            // Only change colors when the run looks different from the previous one
+            if (styles[hl].key != current->key) {
+                current = &styles[hl];
+                abAppend(ab, current->sgr, current->len);
             }
 
-            // reset color at end of line
-            abAppend(ab, "\x1b[39m", 5);
-            abAppend(ab, "\x1b[m", 3);
+            abAppend(ab, &c[i], end - i);
+            i = end;
         }
 
-        // Erase in line escape sequence
-        abAppend(ab, "\x1b[K", 3);
-        abAppend(ab, "\r\n", 2);
+        // reset color at end of line
+        abAppend(ab, "\x1b[m", 3);
+    }
+}
+
+/*
+ * Add screen line `y` with content `line` to append buffer `ab` if it differs from the last frame
+ */
+void editorDrawLine(struct abuf *ab, int y, struct abuf *line) {
+    struct abuf *last = &F.lines[y];
+
+    if (F.valid[y] && last->len == line->len && (line->len == 0 || memcmp(last->b, line->b, line->len) == 0)) {
+        return;
+    }
+
+    // Move to the start of the line, draw it and erase the rest of the line
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "\x1b[%d;1H", y + 1);
+    abAppend(ab, buf, len);
+    abAppend(ab, line->b, line->len);
+    abAppend(ab, "\x1b[K", 3);
+
+    abClear(last);
+    abAppend(last, line->b, line->len);
+    F.valid[y] = true;
+}
+
+/*
+ * Reverse the order of the stored lines from `from` up to (not including) `to`
+ */
+void editorReverseFrameLines(int from, int to) {
+    for (to--; from < to; from++, to--) {
+        struct abuf line = F.lines[from];
+        F.lines[from] = F.lines[to];
+        F.lines[to] = line;
+
+        bool valid = F.valid[from];
+        F.valid[from] = F.valid[to];
+        F.valid[to] = valid;
+    }
+}
+
+/*
+ * Rotate the stored text row lines up by `shift` lines, the lines that scroll in are invalid
+ */
+void editorRotateFrameLines(int shift) {
+    int count = E.screenrows;
+
+    // Rotating by reversing keeps the buffers of all lines for reuse
+    editorReverseFrameLines(0, shift);
+    editorReverseFrameLines(shift, count);
+    editorReverseFrameLines(0, count);
+}
+
+/*
+ * Scroll the rows of the last frame with the terminal when the row offset changed,
+ * so lines that are still visible do not have to be sent again
+ */
+void editorScrollFrame(struct abuf *ab) {
+    int delta = E.row_offset - F.row_offset;
+    F.row_offset = E.row_offset;
+
+    if (delta == 0 || delta >= E.screenrows || -delta >= E.screenrows) {
+        return;
+    }
+
+    // Scroll the text rows only, not the status and message bars
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "\x1b[1;%dr", E.screenrows);
+    abAppend(ab, buf, len);
+
+    if (delta > 0) {
+        // Scroll up (SU), the lines below move up and blank lines appear at the bottom
+        len = snprintf(buf, sizeof(buf), "\x1b[%dS", delta);
+        abAppend(ab, buf, len);
+
+        editorRotateFrameLines(delta);
+        for (int y = E.screenrows - delta; y < E.screenrows; y++) {
+            F.valid[y] = false;
+        }
+    } else {
+        delta = -delta;
+
+        // Scroll down (SD), the lines above move down and blank lines appear at the top
+        len = snprintf(buf, sizeof(buf), "\x1b[%dT", delta);
+        abAppend(ab, buf, len);
+
+        editorRotateFrameLines(E.screenrows - delta);
+        for (int y = 0; y < delta; y++) {
+            F.valid[y] = false;
+        }
+    }
+
+    // Reset the scroll region
+    abAppend(ab, "\x1b[r", 3);
+}
+
+/*
+ * Add the editor rows that changed since the last frame to append buffer `ab`.
+ * empty lines are shown as "~".
+ */
+void editorDrawRows(struct abuf *ab) {
+    editorScrollFrame(ab);
+    editorUpdateGutter();
+
+    // Highlight and render the visible rows that have not been drawn before
+    editorHighlightRows(E.row_offset, E.row_offset + E.screenrows - 1);
+
+    rowIterator it;
+    rowTreeIterate(&E.rows, E.row_offset, &it);
+
+    for (int y = 0; y < E.screenrows; y++) {
+        abClear(&F.line);
+        editorDrawRow(&F.line, y, &it);
+        editorDrawLine(ab, y, &F.line);
     }
 }
 
@@ -288,8 +528,19 @@ void editorDrawStatusBar(struct abuf *ab) {
 
     char status[80], statusRight[80];
 
-    int len = snprintf(status, sizeof(status), " %.20s - %d lines %s",
-            E.filename ? E.filename : "[No filename]", E.numrows, E.dirty ? "(modified)" : "");
+    // Show progress while the file is still being indexed
+    char indexing[32] = "";
+    int progress = editorIndexProgress();
+    if (progress >= 0) {
+        snprintf(indexing, sizeof(indexing), "(indexing %d%%) ", progress);
+    }
+
+    // Show the selected match and the number of matches while searching
+    char matches[64] = "";
+    editorFormatSearchStatus(matches, sizeof(matches));
+
+    int len = snprintf(status, sizeof(status), " %.20s - %d lines %s%s%s",
+            E.filename ? E.filename : "[No filename]", E.numrows, indexing, matches, E.dirty ? "(modified)" : "");
 
     char *filetype = E.syntax ? E.syntax->filetype : "no ft";
     int currentLine = E.cy + 1;
@@ -320,8 +571,7 @@ void editorDrawStatusBar(struct abuf *ab) {
  * Add message bar to append buffer `ab`
  */
 void editorDrawMessageBar(struct abuf *ab) {
-    // Clear line (space is needed for some reason, otherwise line not cleared)
-    abAppend(ab, " \x1b[K", 5);
+    abAppend(ab, " ", 1);
 
     int messageLen = strlen(E.statusMessage);
     if (messageLen > E.screencols) {
@@ -334,26 +584,84 @@ void editorDrawMessageBar(struct abuf *ab) {
 }
 
 /*
- * Clear the screen and draw updated content.
+ * Make sure the last frame has a line for every screen line
+ */
+void editorPrepareFrame() {
+    if (!stylesReady) {
+        editorInitStyles();
+    }
+
+    if (F.overlay_size < E.screencols) {
+        F.overlay = realloc(F.overlay, E.screencols);
+        F.overlay_size = E.screencols;
+    }
+
+    int count = E.screenrows + 2;
+
+    if (F.count == count) {
+        return;
+    }
+
+    for (int y = 0; y < F.count; y++) {
+        abFree(&F.lines[y]);
+    }
+    free(F.lines);
+    free(F.valid);
+
+    F.lines = calloc(count, sizeof(struct abuf));
+    F.valid = calloc(count, sizeof(bool));
+    F.count = count;
+    F.row_offset = E.row_offset;
+}
+
+/*
+ * Redraw every line on the next refresh, e.g. when the terminal content was lost
+ */
+void editorInvalidateFrame() {
+    for (int y = 0; y < F.count; y++) {
+        F.valid[y] = false;
+    }
+}
+
+/*
+ * Draw the lines that changed since the last frame.
 
  * (see https://vt100.net/docs/vt100-ug/chapter3.html0 for VT100 escape sequences)
  */
 void editorRefreshScreen() {
+    // Add the rows found by the background indexer since the last frame
+    editorIngestIndexedLines();
+    // Report the result of a finished background save
+    editorPollSave();
+    // Take the syntax tree published by the parse thread, then reparse the edits of the last frame at once
+    editorPollParse();
+    editorParseEdits();
+    // Show the matches the search threads found since the last frame
+    editorPollSearch();
+
     // Do not scroll the editor when the user is using a prompt
     if (!E.prompt) {
         editorScroll();
     }
 
-    struct abuf ab = ABUF_INIT;
+    editorPrepareFrame();
+
+    // The output buffer is reused, after the first frames drawing does not allocate
+    struct abuf *ab = &F.out;
+    abClear(ab);
 
     // Hide cursor before refeshing the screen
-    abAppend(&ab, "\x1b[?25l", 6);
-    // write 3 byte escape sequence to position the cursor in the top left
-    abAppend(&ab, "\x1b[H", 3);
+    abAppend(ab, "\x1b[?25l", 6);
+
+    editorDrawRows(ab);
+
+    abClear(&F.line);
+    editorDrawStatusBar(&F.line);
+    editorDrawLine(ab, E.screenrows, &F.line);
 
-    editorDrawRows(&ab);
-    editorDrawStatusBar(&ab);
-    editorDrawMessageBar(&ab);
+    abClear(&F.line);
+    editorDrawMessageBar(&F.line);
+    editorDrawLine(ab, E.screenrows + 1, &F.line);
 
     // Draw cursor in correct position
     char buf[32];
@@ -364,11 +672,10 @@ void editorRefreshScreen() {
         snprintf(buf, sizeof(buf), "\x1b[%d;%dH", E.cy,
                                                   E.rx);
     }
-    abAppend(&ab, buf, strlen(buf));
+    abAppend(ab, buf, strlen(buf));
 
     // show cursor after refeshing the screen
-    abAppend(&ab, "\x1b[?25h", 6);
+    abAppend(ab, "\x1b[?25h", 6);
 
-    write(STDOUT_FILENO, ab.b, ab.len);
-    abFree(&ab);
+    write(STDOUT_FILENO, ab->b, ab->len);
 }
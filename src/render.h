@@ -6,12 +6,17 @@
 /*
  * Convert cursor x (`cx`) to rendered x position based on the characters in `row`
  */
-int editorRowCxtoRx(erow *row, int cx);
+int editorRowCxtoRx(erow row, int cx);
+
+/*
+ * Convert cursor x `cx` to rendered x, continuing from the known rendered x `from_rx` of cursor x `from_cx` (<= `cx`)
+ */
+int editorRowCxtoRxFrom(erow row, int from_cx, int from_rx, int cx);
 
 /*
  * Convert rendered x (`rx`) to cursor x position based on the characters in `row`
  */
-int editorRowRxtoCx(erow *row, int rx);
+int editorRowRxtoCx(erow row, int rx);
 
 /*
  * Scroll the screen if the cursor reaches an edge
@@ -24,7 +29,60 @@ void editorScroll();
 void editorCalculateRenderedRows(int start_row, int new_end_row);
 
 /*
- * Add editor rows to append buffer `ab`.
+ * Update the width of the line number column when the number of rows has a different number of digits
+ */
+void editorUpdateGutter();
+
+/*
+ * Write `number` right aligned in `width` characters to `buf`, padded with spaces
+ */
+void editorFormatLineNumber(char *buf, int width, int number);
+
+/*
+ * Fill the table with the SGR escape sequence of every highlight class
+ */
+void editorInitStyles();
+
+/*
+ * Returns `true` if rendered character `i` of `c` (of length `len`) is drawn as a symbol:
+ * control characters, the '^' in front of them and non-ASCII characters
+ */
+bool editorIsSymbol(char *c, int i, int len);
+
+/*
+ * Return the highlight of render column `i`, the highlight in `overlay` (if any) is drawn over the syntax highlight
+ */
+int editorCellHighlight(const unsigned char *highlight, const unsigned char *overlay, int i);
+
+/*
+ * Add screen line `y` to append buffer `ab`, the row at `it` is drawn if `y` shows a row.
+ * empty lines are shown as "~".
+ */
+void editorDrawRow(struct abuf *ab, int y, rowIterator *it);
+
+/*
+ * Add screen line `y` with content `line` to append buffer `ab` if it differs from the last frame
+ */
+void editorDrawLine(struct abuf *ab, int y, struct abuf *line);
+
+/*
+ * Reverse the order of the stored lines from `from` up to (not including) `to`
+ */
+void editorReverseFrameLines(int from, int to);
+
+/*
+ * Rotate the stored text row lines up by `shift` lines, the lines that scroll in are invalid
+ */
+void editorRotateFrameLines(int shift);
+
+/*
+ * Scroll the rows of the last frame with the terminal when the row offset changed,
+ * so lines that are still visible do not have to be sent again
+ */
+void editorScrollFrame(struct abuf *ab);
+
+/*
+ * Add the editor rows that changed since the last frame to append buffer `ab`.
  * empty lines are shown as "~".
  */
 void editorDrawRows(struct abuf *ab);
@@ -40,7 +98,17 @@ void editorDrawStatusBar(struct abuf *ab);
 void editorDrawMessageBar(struct abuf *ab);
 
 /*
- * Clear the screen and draw updated content.
+ * Make sure the last frame has a line for every screen line
+ */
+void editorPrepareFrame();
+
+/*
+ * Redraw every line on the next refresh, e.g. when the terminal content was lost
+ */
+void editorInvalidateFrame();
+
+/*
+ * Draw the lines that changed since the last frame.
 
  * (see https://vt100.net/docs/vt100-ug/chapter3.html0 for VT100 escape sequences)
  */
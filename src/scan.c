@@ -0,0 +1,129 @@
+#include "scan.h"
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+/*** byte search ***/
+
+/*
+ * Search `query` (of at least 2 characters) one candidate at a time, used for the end of the text
+ * and on architectures without a vectorized kernel
+ */
+const char *editorFindBytesScalar(const char *text, size_t size, const char *query, size_t len) {
+    if (size < len) {
+        return NULL;
+    }
+
+    const char *last = text + size - len;
+
+    for (const char *candidate = text; candidate <= last; candidate++) {
+        candidate = memchr(candidate, query[0], last - candidate + 1);
+
+        if (candidate == NULL) {
+            return NULL;
+        }
+
+        if (!memcmp(candidate + 1, query + 1, len - 1)) {
+            return candidate;
+        }
+    }
+
+    return NULL;
+}
+
+#ifdef __x86_64__
+
+/*
+ * Search `query` (of at least 2 characters) 16 positions at a time (SSE2, available on every x86-64 CPU).
+ * Only positions where both the first and the last character of the query match are compared completely,
+ * which filters out nearly all positions in ordinary text.
+ */
+const char *editorFindBytesSSE2(const char *text, size_t size, const char *query, size_t len) {
+    const __m128i first = _mm_set1_epi8(query[0]);
+    const __m128i last = _mm_set1_epi8(query[len - 1]);
+
+    size_t i = 0;
+    for (; i + len - 1 + 16 <= size; i += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i *)(text + i));
+        __m128i block_last = _mm_loadu_si128((const __m128i *)(text + i + len - 1));
+
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                                                        _mm_cmpeq_epi8(block_last, last)));
+
+        while (mask != 0) {
+            int offset = __builtin_ctz(mask);
+
+            if (!memcmp(text + i + offset + 1, query + 1, len - 2)) {
+                return text + i + offset;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+
+    return editorFindBytesScalar(text + i, size - i, query, len);
+}
+
+/*
+ * Search `query` (of at least 2 characters) 32 positions at a time, see editorFindBytesSSE2
+ */
+__attribute__((target("avx2")))
+const char *editorFindBytesAVX2(const char *text, size_t size, const char *query, size_t len) {
+    const __m256i first = _mm256_set1_epi8(query[0]);
+    const __m256i last = _mm256_set1_epi8(query[len - 1]);
+
+    size_t i = 0;
+    for (; i + len - 1 + 32 <= size; i += 32) {
+        __m256i block_first = _mm256_loadu_si256((const __m256i *)(text + i));
+        __m256i block_last = _mm256_loadu_si256((const __m256i *)(text + i + len - 1));
+
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                                                              _mm256_cmpeq_epi8(block_last, last)));
+
+        while (mask != 0) {
+            int offset = __builtin_ctz(mask);
+
+            if (!memcmp(text + i + offset + 1, query + 1, len - 2)) {
+                return text + i + offset;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+
+    return editorFindBytesSSE2(text + i, size - i, query, len);
+}
+
+#endif
+
+/*
+ * Return a pointer to the first occurrence of the `len` characters of `query` in the `size` characters of `text`,
+ * NULL if there is none. Like memmem, but with a vectorized kernel on x86-64.
+ */
+const char *editorFindBytes(const char *text, size_t size, const char *query, size_t len) {
+    if (len == 0) {
+        return text;
+    }
+
+    if (len > size) {
+        return NULL;
+    }
+
+    // memchr is vectorized already
+    if (len == 1) {
+        return memchr(text, query[0], size);
+    }
+
+#ifdef __x86_64__
+    if (__builtin_cpu_supports("avx2")) {
+        return editorFindBytesAVX2(text, size, query, len);
+    }
+
+    return editorFindBytesSSE2(text, size, query, len);
+#else
+    return editorFindBytesScalar(text, size, query, len);
+#endif
+}
@@ -0,0 +1,12 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+/*
+ * Return a pointer to the first occurrence of the `len` characters of `query` in the `size` characters of `text`,
+ * NULL if there is none. Like memmem, but with a vectorized kernel on x86-64.
+ */
+const char *editorFindBytes(const char *text, size_t size, const char *query, size_t len);
+
+#endif
@@ -1,108 +1,723 @@
+#include "dfa.h"
 #include "editor.h"
 #include "highlight.h"
 #include "input.h"
+#include "lineindex.h"
 #include "prompt.h"
+#include "render.h"
+#include "scan.h"
+#include "search.h"
+#include "terminal.h"
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 extern struct editorConfig E;
 
+/*
+ * Position and length of a match of the search query, `col` is an index into the characters of the row
+ */
+struct editorMatch {
+    int row;
+    int col;
+    int len;
+};
+
+/*
+ * Growable list of matches, sorted by row and column
+ */
+struct editorMatchList {
+    struct editorMatch *items;
+    int count;
+    int capacity;
+};
+
+/*
+ * State of the search prompt, kept between keypresses (only used by the editor thread)
+ */
+struct editorSearchState {
+    // Query the matches are found for, NULL before the first search
+    char *query;
+    size_t query_len;
+
+    // Set when the query is a regular expression (toggled in the prompt), `matches_regex` when the matches are for one
+    bool regex_mode;
+    bool matches_regex;
+    // Compiled query in regex mode, or why it could not be compiled
+    struct editorRegex *regex;
+    const char *regex_error;
+
+    // Every match of `query` found so far, text matches may overlap
+    struct editorMatchList matches;
+
+    // Index of the selected match, -1 without matches
+    int current;
+
+    // Cursor position when the search started, the first match after it is selected
+    int start_row;
+    int start_col;
+};
+
+struct editorSearchState SE = { NULL, 0, false, false, NULL, NULL, { NULL, 0, 0 }, -1, 0, 0 };
+
+/*
+ * Search of the whole buffer by the search threads.
+ * The rows are split into chunks of SEARCH_CHUNK_ROWS rows, each thread takes the next chunk that was not searched yet.
+ * The rows are not modified while the search prompt is open, so the threads read them without locking.
+ */
+struct editorSearchJob {
+    pthread_t threads[SEARCH_MAX_THREADS];
+    int thread_count;
+
+    // Protects all fields below, except `merged`
+    pthread_mutex_t lock;
+    // Signalled when a search is started
+    pthread_cond_t requested;
+    // Signalled when the last thread searching a chunk finishes
+    pthread_cond_t stopped;
+
+    // Query of the running search (compiled in regex mode, the threads share it) and the number of rows when it started
+    char *query;
+    size_t len;
+    const struct editorRegex *regex;
+    int numrows;
+
+    // Matches of every chunk, `done` is set once the chunk is searched completely
+    struct editorMatchList *chunks;
+    bool *done;
+    int chunk_count;
+
+    // Next chunk to search and the number of threads searching a chunk
+    int next;
+    int busy;
+
+    // Set to stop the threads early when the search is replaced, checked between runs of rows
+    int cancel;
+
+    // Number of chunks (in order) whose matches were moved to the search state (only used by the editor thread)
+    int merged;
+};
+
+struct editorSearchJob SJ = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .requested = PTHREAD_COND_INITIALIZER,
+    .stopped = PTHREAD_COND_INITIALIZER,
+};
+
 /*** find/search ***/
 
 /*
- * Method called after user types in the find prompt.
- * Takes the current `query` and pressed `key` as parameters.
+ * Add a match of `len` characters at `col` of row `row` to the end of `list`
  */
-void editorFindCallback(char *query, int key) {
-    // Save the search status between calls
-    static int last_match = -1;
-    static int direction = 1;
+void editorAddMatch(struct editorMatchList *list, int row, int col, int len) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->items = realloc(list->items, sizeof(struct editorMatch) * list->capacity);
+    }
 
-    static int saved_highlight_line;
-    static char *saved_highlight = NULL;
+    list->items[list->count].row = row;
+    list->items[list->count].col = col;
+    list->items[list->count].len = len;
+    list->count++;
+}
 
-    // If there is a saved highlight, set it to the saved highlight line.
-    // This is done to remove the search result highlight from previous matches.
-    if (saved_highlight) {
-        memcpy(E.row[saved_highlight_line].highlight, saved_highlight, E.row[saved_highlight_line].renderSize);
-        free(saved_highlight);
-        saved_highlight = NULL;
+/*
+ * Returns `true` if the characters at `start` follow the characters ending at `end`, only separated by a line break.
+ * Both must point into the memory mapped file.
+ */
+bool editorTextAdjacent(const char *end, const char *start) {
+    if (start <= end) {
+        return false;
     }
 
-    // Return on escape
-    if (key == '\x1b') {
-        last_match = -1;
-        direction = 1;
+    for (const char *c = end; c < start; c++) {
+        if (*c != '\n' && *c != '\r') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Add the matches of `query` in the text from `text` to `end`, which starts at `row` (at line `at`)
+ * and may continue in the rows after it
+ */
+void editorScanRun(struct editorMatchList *list, const char *text, const char *end, erow row, int at,
+                   const char *query, size_t len) {
+    // Matches are found in order, so the row of each match is found by walking the rows along with them.
+    // Matches may overlap, so a longer query can be searched among them, see editorRefineMatches.
+    for (const char *match = text; (match = editorFindBytes(match, end - match, query, len)) != NULL; match++) {
+        while (match >= ROW_CHARS(row) + ROW_SIZE(row)) {
+            if (++row.slot == row.leaf->count) {
+                row.leaf = row.leaf->next;
+                row.slot = 0;
+            }
+
+            at++;
+        }
+
+        editorAddMatch(list, at, match - ROW_CHARS(row), len);
+    }
+}
+
+/*
+ * Add every match of the `len` characters of `query` in the rows from `start_row` up to (not including) `end_row`
+ * to `list`. Returns `false` if the search was cancelled before all rows were searched.
+ * Runs of unmodified rows are searched as one text in the memory mapped file, so the search kernel
+ * is not started again for every (short) row. Line breaks can only be part of a match if `query` has one.
+ */
+bool editorScanMatches(struct editorMatchList *list, const char *query, size_t len, int start_row, int end_row) {
+    bool join_rows = memchr(query, '\n', len) == NULL && memchr(query, '\r', len) == NULL;
+
+    rowIterator it;
+    rowTreeIterate(&E.rows, start_row, &it);
+
+    // First row, text and end of the current run of rows
+    erow first = ROW_NONE;
+    int first_at = 0;
+    const char *text = NULL;
+    const char *end = NULL;
+    bool end_mapped = false;
+
+    rowLeaf *leaf = it.leaf;
+    int slot = it.slot;
+
+    for (int at = start_row; at < end_row; at++, slot++) {
+        if (slot == leaf->count) {
+            leaf = leaf->next;
+            slot = 0;
+        }
+
+        const char *chars = leaf->chars[slot];
+        const char *row_end = chars + leaf->size[slot];
+
+        // Rows are nearly always separated by a single newline, which is checked first without a call
+        if (join_rows && end_mapped && leaf->mapped[slot] &&
+            (chars == end + 1 ? *end == '\n' : editorTextAdjacent(end, chars))) {
+            end = row_end;
+            continue;
+        }
+
+        if (ROW_EXISTS(first)) {
+            if (__atomic_load_n(&SJ.cancel, __ATOMIC_RELAXED)) {
+                return false;
+            }
+
+            editorScanRun(list, text, end, first, first_at, query, len);
+        }
+
+        first = (erow){ leaf, slot };
+        first_at = at;
+        text = chars;
+        end = row_end;
+        end_mapped = leaf->mapped[slot];
+    }
+
+    if (ROW_EXISTS(first)) {
+        editorScanRun(list, text, end, first, first_at, query, len);
+    }
+
+    return true;
+}
+
+/*
+ * Add every match of `regex` in the rows from `start_row` up to (not including) `end_row` to `list`.
+ * Returns `false` if the search was cancelled before all rows were searched.
+ * Each call scans with a matcher of its own, so the search threads build the DFA states they need independently.
+ */
+bool editorScanRegex(struct editorMatchList *list, const struct editorRegex *regex, int start_row, int end_row) {
+    struct editorRegexMatcher *matcher = editorRegexMatcherNew(regex);
+    bool complete = true;
+
+    rowIterator it;
+    rowTreeIterate(&E.rows, start_row, &it);
+
+    for (int at = start_row; at < end_row; at++) {
+        if (__atomic_load_n(&SJ.cancel, __ATOMIC_RELAXED)) {
+            complete = false;
+            break;
+        }
+
+        erow row = rowIteratorNext(&it);
+
+        int from = 0;
+        int start, end;
+
+        // Matches are not empty, so every match moves the scan forward
+        while (editorRegexFind(matcher, ROW_CHARS(row), ROW_SIZE(row), from, &start, &end)) {
+            editorAddMatch(list, at, start, end - start);
+            from = end;
+        }
+    }
+
+    editorRegexMatcherFree(matcher);
+    return complete;
+}
+
+/*
+ * Add the matches of the query in the rows from `start_row` up to (not including) `end_row` to `list`,
+ * of compiled `regex` in regex mode and of the `len` characters of `query` otherwise.
+ * Returns `false` if the search was cancelled before all rows were searched.
+ */
+bool editorSearchRows(struct editorMatchList *list, const char *query, size_t len, const struct editorRegex *regex,
+                      int start_row, int end_row) {
+    if (regex != NULL) {
+        return editorScanRegex(list, regex, start_row, end_row);
+    }
+
+    return editorScanMatches(list, query, len, start_row, end_row);
+}
+
+/*
+ * Search thread: search the chunks of the running search until all of them are taken
+ */
+void *editorSearchWorker(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&SJ.lock);
+
+    while (true) {
+        while (SJ.next >= SJ.chunk_count) {
+            pthread_cond_wait(&SJ.requested, &SJ.lock);
+        }
+
+        int chunk = SJ.next++;
+        SJ.busy++;
+
+        // The chunk's list is only used by this thread until it is done
+        struct editorMatchList *list = &SJ.chunks[chunk];
+        const char *query = SJ.query;
+        size_t len = SJ.len;
+        const struct editorRegex *regex = SJ.regex;
+        int start_row = chunk * SEARCH_CHUNK_ROWS;
+        int end_row = start_row + SEARCH_CHUNK_ROWS < SJ.numrows ? start_row + SEARCH_CHUNK_ROWS : SJ.numrows;
+
+        pthread_mutex_unlock(&SJ.lock);
+
+        bool complete = editorSearchRows(list, query, len, regex, start_row, end_row);
+
+        pthread_mutex_lock(&SJ.lock);
+
+        SJ.done[chunk] = complete;
+
+        if (--SJ.busy == 0) {
+            pthread_cond_broadcast(&SJ.stopped);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Returns `true` while the search threads search the buffer, or found matches that were not merged yet
+ */
+bool editorSearching() {
+    return SJ.merged < SJ.chunk_count;
+}
+
+/*
+ * Stop the running search, waits until no search thread reads the rows anymore
+ */
+void editorStopSearch() {
+    if (SJ.chunk_count == 0) {
         return;
-    } else if (key == '\r') {
-        direction = 0;
-    } else if (key == DOWN) {
-        direction = 1;
-    } else if (key == UP) {
-        direction = -1;
-    } else {
-        last_match = -1;
-        direction = 1;
     }
 
-    if (last_match == -1) {
-        direction = 1;
+    pthread_mutex_lock(&SJ.lock);
+
+    // Chunks that were not taken yet are skipped, chunks being searched are left early
+    __atomic_store_n(&SJ.cancel, 1, __ATOMIC_RELAXED);
+    SJ.next = SJ.chunk_count;
+
+    while (SJ.busy > 0) {
+        pthread_cond_wait(&SJ.stopped, &SJ.lock);
+    }
+
+    __atomic_store_n(&SJ.cancel, 0, __ATOMIC_RELAXED);
+
+    for (int i = 0; i < SJ.chunk_count; i++) {
+        free(SJ.chunks[i].items);
     }
-    int current = last_match;
 
-    for (int i = 0; i < E.numrows; i++) {
-        current += direction;
+    free(SJ.chunks);
+    free(SJ.done);
+    free(SJ.query);
+    SJ.chunks = NULL;
+    SJ.done = NULL;
+    SJ.query = NULL;
+    SJ.regex = NULL;
+    SJ.chunk_count = 0;
+    SJ.next = 0;
+    SJ.merged = 0;
+
+    pthread_mutex_unlock(&SJ.lock);
+}
 
-        // Wrap around
-        if (current == -1) {
-            current = E.numrows - 1;
-        } else if (current == E.numrows) {
-            current = 0;
+/*
+ * Search all rows for the `len` characters of `query` (or compiled `regex`) on the search threads,
+ * replacing the running search. The matches are merged into the search state in order by editorPollSearch.
+ */
+void editorStartSearch(const char *query, size_t len, const struct editorRegex *regex) {
+    editorStopSearch();
+
+    if (SJ.thread_count == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        SJ.thread_count = cpus < 1 ? 1 : cpus > SEARCH_MAX_THREADS ? SEARCH_MAX_THREADS : cpus;
+
+        for (int i = 0; i < SJ.thread_count; i++) {
+            if (pthread_create(&SJ.threads[i], NULL, editorSearchWorker, NULL) != 0) {
+                die("pthread_create");
+            }
         }
+    }
 
-        erow *row = &E.row[current];
-        char *match = strstr(row->render, query);
+    pthread_mutex_lock(&SJ.lock);
 
-        if (match) {
-            last_match = current;
-            int pos = match - row->render;
+    SJ.query = malloc(len);
+    memcpy(SJ.query, query, len);
+    SJ.len = len;
+    SJ.regex = regex;
+    SJ.numrows = E.numrows;
 
-            // Scroll to the match, the match will appear at the top of the screen
-            E.row_offset = current;
+    SJ.chunk_count = (E.numrows + SEARCH_CHUNK_ROWS - 1) / SEARCH_CHUNK_ROWS;
+    SJ.chunks = calloc(SJ.chunk_count, sizeof(struct editorMatchList));
+    SJ.done = calloc(SJ.chunk_count, sizeof(bool));
+    SJ.next = 0;
+    SJ.merged = 0;
 
-            // Place cursor at match on carriage return
-            if (key == '\r') {
-                E.cy = current;
-                E.cx = pos;
+    pthread_cond_broadcast(&SJ.requested);
+    pthread_mutex_unlock(&SJ.lock);
+}
 
-                // reset saved match and direction
-                last_match = -1;
-                direction = 1;
+/*
+ * Keep the matches of the previous query that are also matches of `query`.
+ * The previous query is at `offset` in `query`, so every match of `query` contains a match of the previous query.
+ */
+void editorRefineMatches(const char *query, size_t len, size_t offset) {
+    int kept = 0;
+
+    // The matches are sorted by row, so the rows are visited in order without looking each of them up
+    rowIterator it;
+    rowTreeIterate(&E.rows, 0, &it);
+
+    int next_row = 0;
+    erow row = ROW_NONE;
+
+    for (int i = 0; i < SE.matches.count; i++) {
+        struct editorMatch match = SE.matches.items[i];
+        match.col -= offset;
+
+        if (match.row >= next_row) {
+            rowIteratorSkip(&it, match.row - next_row);
+            row = rowIteratorNext(&it);
+            next_row = match.row + 1;
+        }
+
+        if (match.col < 0 || match.col + len > (size_t)ROW_SIZE(row)) {
+            continue;
+        }
+
+        if (!memcmp(&ROW_CHARS(row)[match.col], query, len)) {
+            match.len = len;
+            SE.matches.items[kept++] = match;
+        }
+    }
+
+    SE.matches.count = kept;
+}
+
+/*
+ * Update the match list for `query`.
+ * Only the previous matches are checked when `query` contains the previous query, e.g. after typing a character,
+ * unless there are so many of them that scanning all rows again is faster.
+ * Otherwise small buffers are searched right away, larger ones by the search threads.
+ * In regex mode the query is compiled once, the rows are scanned with the compiled pattern.
+ */
+void editorUpdateMatches(const char *query) {
+    size_t len = strlen(query);
+
+    if (SE.query != NULL && SE.matches_regex == SE.regex_mode && len == SE.query_len && !memcmp(query, SE.query, len)) {
+        return;
+    }
+
+    // Matches of a regular expression cannot be refined by text
+    const char *previous = NULL;
+    if (!SE.regex_mode && !SE.matches_regex && SE.query != NULL && SE.query_len > 0) {
+        previous = editorFindBytes(query, len, SE.query, SE.query_len);
+    }
+
+    if (previous != NULL && !editorSearching() && SE.matches.count < E.numrows) {
+        editorRefineMatches(query, len, previous - query);
+    } else {
+        // The search threads may use the compiled query until they are stopped
+        editorStopSearch();
+        SE.matches.count = 0;
+
+        editorRegexFree(SE.regex);
+        SE.regex = NULL;
+        SE.regex_error = NULL;
+
+        if (len > 0 && SE.regex_mode) {
+            SE.regex = editorRegexCompile(query, len, &SE.regex_error);
+        }
+
+        // An invalid regular expression has no matches
+        if (len > 0 && (!SE.regex_mode || SE.regex != NULL)) {
+            if (E.numrows <= SEARCH_CHUNK_ROWS) {
+                editorSearchRows(&SE.matches, query, len, SE.regex, 0, E.numrows);
+            } else {
+                editorStartSearch(query, len, SE.regex);
             }
+        }
+    }
 
-            saved_highlight_line = current;
-            saved_highlight = malloc(row->size);
-            memcpy(saved_highlight, row->highlight, row->renderSize);
-            // mempcpy(saved_highlight, row->highlight, row->renderSize);
-            memset(&row->highlight[pos], HL_MATCH, strlen(query));
-            break;
+    free(SE.query);
+    SE.query = strdup(query);
+    SE.query_len = len;
+    SE.matches_regex = SE.regex_mode;
+}
+
+/*
+ * Return the index of the first match at or after column `col` of row `row`, the number of matches if there is none
+ */
+int editorFindMatchAfter(int row, int col) {
+    int low = 0;
+    int high = SE.matches.count;
+
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        struct editorMatch *match = &SE.matches.items[middle];
+
+        if (match->row < row || (match->row == row && match->col < col)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/*
+ * Select the first match after the position the search started at, wrapping around to the first match.
+ * Nothing is selected while the search threads may still find an earlier match.
+ */
+void editorSelectFirstMatch() {
+    int index = editorFindMatchAfter(SE.start_row, SE.start_col);
+
+    if (index < SE.matches.count) {
+        SE.current = index;
+    } else if (SE.matches.count > 0 && !editorSearching()) {
+        SE.current = 0;
+    } else {
+        SE.current = -1;
+    }
+}
+
+/*
+ * Scroll to the selected match, unless it is visible already
+ */
+void editorShowMatch() {
+    struct editorMatch *match = &SE.matches.items[SE.current];
+
+    // The match will appear at the top of the screen
+    if (match->row < E.row_offset || match->row >= E.row_offset + E.screenrows) {
+        E.row_offset = match->row;
+    }
+}
+
+/*
+ * Mark the matches in row `row` (at line `at`) in `overlay`, which holds the highlight of the `len` render columns
+ * from `col_offset`, with HL_MATCH (HL_MATCH_SELECTED for the selected match) and every other column with HL_NORMAL.
+ * Returns `false` if none of the matches are visible, `overlay` is not written then.
+ */
+bool editorOverlayMatches(erow row, int at, unsigned char *overlay, int col_offset, int len) {
+    if (SE.query == NULL || SE.matches.count == 0) {
+        return false;
+    }
+
+    bool marked = false;
+
+    // The matches of the row are sorted by column, so their render columns are found in one pass over the row
+    int cx = 0;
+    int rx = 0;
+
+    for (int i = editorFindMatchAfter(at, 0); i < SE.matches.count && SE.matches.items[i].row == at; i++) {
+        struct editorMatch *match = &SE.matches.items[i];
+
+        int match_end = match->col + match->len < ROW_SIZE(row) ? match->col + match->len : ROW_SIZE(row);
+
+        int start = editorRowCxtoRxFrom(row, cx, rx, match->col);
+        int end = editorRowCxtoRxFrom(row, match->col, start, match_end);
+        cx = match->col;
+        rx = start;
+
+        // Columns relative to the first visible column
+        start = start - col_offset < 0 ? 0 : start - col_offset;
+        end = end - col_offset > len ? len : end - col_offset;
+
+        if (start >= end) {
+            continue;
+        }
+
+        if (!marked) {
+            memset(overlay, HL_NORMAL, len);
+            marked = true;
+        }
+
+        memset(&overlay[start], i == SE.current ? HL_MATCH_SELECTED : HL_MATCH, end - start);
+    }
+
+    return marked;
+}
+
+/*
+ * Merge the chunks the search threads finished (in order) into the match list,
+ * and show the first match after the cursor once it is known
+ */
+void editorPollSearch() {
+    if (!editorSearching()) {
+        return;
+    }
+
+    pthread_mutex_lock(&SJ.lock);
+
+    while (SJ.merged < SJ.chunk_count && SJ.done[SJ.merged]) {
+        struct editorMatchList *chunk = &SJ.chunks[SJ.merged];
+
+        for (int i = 0; i < chunk->count; i++) {
+            editorAddMatch(&SE.matches, chunk->items[i].row, chunk->items[i].col, chunk->items[i].len);
+        }
+
+        free(chunk->items);
+        chunk->items = NULL;
+        SJ.merged++;
+    }
+
+    pthread_mutex_unlock(&SJ.lock);
+
+    // All chunks are merged, the threads are idle
+    if (!editorSearching()) {
+        editorStopSearch();
+    }
+
+    if (SE.current == -1) {
+        editorSelectFirstMatch();
+
+        if (SE.current != -1) {
+            editorShowMatch();
         }
     }
 }
 
+/*
+ * Write the state of the search to `buf` for the status bar, e.g. "(match 3 of 10) ".
+ * Nothing is written while the search prompt is closed.
+ */
+void editorFormatSearchStatus(char *buf, size_t size) {
+    const char *mode = SE.regex_mode ? "regex, " : "";
+    // The number of matches grows while the search threads find more
+    const char *searching = editorSearching() ? ", searching" : "";
+
+    if (SE.query == NULL) {
+        buf[0] = '\0';
+    } else if (SE.regex_error != NULL) {
+        snprintf(buf, size, "(invalid regex: %s) ", SE.regex_error);
+    } else if (SE.query_len == 0) {
+        snprintf(buf, size, SE.regex_mode ? "(regex) " : "");
+    } else if (SE.current >= 0) {
+        snprintf(buf, size, "(%smatch %d of %d%s) ", mode, SE.current + 1, SE.matches.count, searching);
+    } else {
+        snprintf(buf, size, "(%s%d matches%s) ", mode, SE.matches.count, searching);
+    }
+}
+
+/*
+ * Forget the query and its matches
+ */
+void editorEndSearch() {
+    editorStopSearch();
+
+    free(SE.query);
+    SE.query = NULL;
+    SE.query_len = 0;
+    SE.matches.count = 0;
+    SE.current = -1;
+
+    editorRegexFree(SE.regex);
+    SE.regex = NULL;
+    SE.regex_error = NULL;
+}
+
+/*
+ * Method called after user types in the find prompt.
+ * Takes the current `query` and pressed `key` as parameters.
+ */
+void editorFindCallback(char *query, int key) {
+    // Return on escape
+    if (key == '\x1b') {
+        editorEndSearch();
+        return;
+    }
+
+    if (SE.query == NULL) {
+        SE.start_row = E.cy;
+        SE.start_col = E.cx;
+    }
+
+    // Switch between text and regular expression search
+    if (key == CTRL_KEY('r')) {
+        SE.regex_mode = !SE.regex_mode;
+    }
+
+    if (SE.query == NULL || strcmp(query, SE.query) || SE.matches_regex != SE.regex_mode) {
+        editorUpdateMatches(query);
+        editorSelectFirstMatch();
+    } else if (SE.current != -1 && key == DOWN) {
+        SE.current = (SE.current + 1) % SE.matches.count;
+    } else if (SE.current != -1 && key == UP) {
+        SE.current = (SE.current - 1 + SE.matches.count) % SE.matches.count;
+    }
+
+    // Place cursor at match on carriage return
+    if (key == '\r') {
+        if (SE.current != -1) {
+            struct editorMatch *match = &SE.matches.items[SE.current];
+
+            E.row_offset = match->row;
+            E.cy = match->row;
+            E.cx = match->col;
+            E.savedCx = E.cx;
+        }
+
+        editorEndSearch();
+        return;
+    }
+
+    if (SE.current != -1) {
+        editorShowMatch();
+    }
+}
+
 /*
  * Search for query in opened file, search executed after each keypress.
  * Pressing return will keep put the cursor at the match.
  * Pressing escape will return the cursor to the position before the search.
  */
 void editorFind() {
+    // Search the whole file, not only the rows indexed so far
+    editorFinishIndexing();
+
     int savedCx = E.cx;
     int savedCy = E.cy;
     int savedColumnOffset = E.col_offset;
     int savedRowOffset = E.row_offset;
 
-    char *query = editorPrompt("Search: %s (ESC = cancel, Arrow up/down = next/prev, Enter = select)", 9, editorFindCallback);
+    char *query = editorPrompt("Search: %s (ESC = cancel, Arrow up/down = next/prev, Enter = select, Ctrl-R = regex)", 9, editorFindCallback);
 
     if (query) {
         free(query);
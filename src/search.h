@@ -1,6 +1,49 @@
 #ifndef SEARCH_H
 #define SEARCH_H
 
+#include "editor.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Maximum number of search threads, one per CPU is started
+ */
+#define SEARCH_MAX_THREADS 8
+
+/*
+ * Number of rows the search threads search at once, buffers with fewer rows are searched by the editor thread
+ */
+#define SEARCH_CHUNK_ROWS (1 << 16)
+
+/*
+ * Input timeout (in milliseconds) while searching in the background, so new matches are shown without waiting for a key
+ */
+#define SEARCH_INPUT_TIMEOUT 10
+
+/*
+ * Returns `true` while the search threads search the buffer, or found matches that were not merged yet
+ */
+bool editorSearching();
+
+/*
+ * Merge the chunks the search threads finished (in order) into the match list,
+ * and show the first match after the cursor once it is known
+ */
+void editorPollSearch();
+
+/*
+ * Write the state of the search to `buf` for the status bar, e.g. "(match 3 of 10) ".
+ * Nothing is written while the search prompt is closed.
+ */
+void editorFormatSearchStatus(char *buf, size_t size);
+
+/*
+ * Mark the matches in row `row` (at line `at`) in `overlay`, which holds the highlight of the `len` render columns
+ * from `col_offset`, with HL_MATCH (HL_MATCH_SELECTED for the selected match) and every other column with HL_NORMAL.
+ * Returns `false` if none of the matches are visible, `overlay` is not written then.
+ */
+bool editorOverlayMatches(erow row, int at, unsigned char *overlay, int col_offset, int len);
+
 /*
  * Search for query in opened file, search executed after each keypress.
  * Pressing return will keep put the cursor at the match.
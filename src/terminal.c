@@ -81,6 +81,22 @@ void enableRawMode() {
     }
 }
 
+/*
+ * Stop the terminal from marking pasted text
+ */
+void disableBracketedPaste() {
+    write(STDOUT_FILENO, "\x1b[?2004l", 8);
+}
+
+/*
+ * Have the terminal mark pasted text with ESC[200~ and ESC[201~, so it can be inserted at once
+ */
+void enableBracketedPaste() {
+    write(STDOUT_FILENO, "\x1b[?2004h", 8);
+
+    atexit(disableBracketedPaste);
+}
+
 /*
  * Get the cursor position, store it in `rows` and `cols`
  */
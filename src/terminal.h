@@ -21,6 +21,16 @@ void disableRawMode();
  */
 void enableRawMode();
 
+/*
+ * Stop the terminal from marking pasted text
+ */
+void disableBracketedPaste();
+
+/*
+ * Have the terminal mark pasted text with ESC[200~ and ESC[201~, so it can be inserted at once
+ */
+void enableBracketedPaste();
+
 /*
  * Get the cursor position, store it in `rows` and `cols`
  */